@@ -0,0 +1,50 @@
+#version 430 core
+// Frustum culling for the indirect draw path (see Indirect_BuildFrame): one
+// invocation per cull record, writing its draw command with one instance when
+// the bounding sphere touches the frustum (and, for the camera, the record
+// wasn't found occluded) and none otherwise.
+layout (local_size_x = 64) in;
+
+struct CullRecord {
+    vec4 sphere;               // world center, radius
+    uint count;
+    uint firstIndex;
+    int  baseVertex;
+    uint baseInstance;
+    uint occluded;             // see Occlusion Culling in main.cpp
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int  baseVertex;
+    uint baseInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Records { CullRecord records[]; };
+layout (std430, binding = 1) writeonly buffer Commands { DrawCommand commands[]; };
+
+uniform vec4 planes[6];        // inward normals, normalized (extractFrustumPlanes)
+uniform int recordCount;
+uniform int outputOffset;
+uniform int skipOccluded;      // 1 for the camera frustum
+
+void main()
+{
+    int i = int(gl_GlobalInvocationID.x);
+    if (i >= recordCount) return;
+    CullRecord r = records[i];
+
+    bool visible = skipOccluded == 0 || r.occluded == 0u;
+    for (int p = 0; p < 6; ++p)
+        if (dot(planes[p].xyz, r.sphere.xyz) + planes[p].w < -r.sphere.w) visible = false;
+
+    DrawCommand c;
+    c.count = r.count;
+    c.instanceCount = visible ? 1u : 0u;
+    c.firstIndex = r.firstIndex;
+    c.baseVertex = r.baseVertex;
+    c.baseInstance = r.baseInstance;
+    commands[outputOffset + i] = c;
+}
@@ -1,32 +1,40 @@
 #version 330 core
+// Static, SKINNED and INSTANCED variants, same attribute locations as main.vs
 
 layout(location = 0) in vec3 aPos;
-layout(location = 3) in ivec4 aBoneIDs;
-layout(location = 4) in vec4 aWeights;
+#ifdef SKINNED
+layout(location = 5) in ivec4 aBoneIDs;
+layout(location = 6) in vec4 aWeights;
+#endif
+#ifdef INSTANCED
+layout(location = 8) in mat4 aModel;    // per instance, see Variants_Draw
+#endif
 
 uniform mat4 model;
 uniform mat4 lightSpaceMatrix;
-uniform bool isAnimated;
+#ifdef SKINNED
 const int MAX_BONES = 100;
 uniform mat4 finalBonesMatrices[MAX_BONES];
+#endif
 
 void main()
 {
-    vec4 worldPos;
-    if (isAnimated) {
-        vec4 skinnedPos = vec4(0.0);
-        for (int i = 0; i < 4; ++i) {
-            int id = aBoneIDs[i];
-            float w = aWeights[i];
-            if (id >= 0 && w > 0.0) {
-                mat4 bone = finalBonesMatrices[id];
-                skinnedPos += bone * vec4(aPos, 1.0) * w;
-            }
+#ifdef SKINNED
+    vec4 skinnedPos = vec4(0.0);
+    for (int i = 0; i < 4; ++i) {
+        int id = aBoneIDs[i];
+        float w = aWeights[i];
+        if (id >= 0 && id < MAX_BONES && w > 0.0) {
+            mat4 bone = finalBonesMatrices[id];
+            skinnedPos += bone * vec4(aPos, 1.0) * w;
         }
-        worldPos = model * skinnedPos;
-    } else {
-        worldPos = model * vec4(aPos, 1.0);
     }
+    vec4 worldPos = model * skinnedPos;
+#elif defined(INSTANCED)
+    vec4 worldPos = aModel * vec4(aPos, 1.0);
+#else
+    vec4 worldPos = model * vec4(aPos, 1.0);
+#endif
 
     gl_Position = lightSpaceMatrix * worldPos;
-}
\ No newline at end of file
+}
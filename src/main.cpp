@@ -6,14 +6,15 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 #include <learnopengl/filesystem.h>
-#include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 //#include <learnopengl/model.h>
 #include <learnopengl/model_animation.h>
-#include <learnopengl/animator.h>
-#include <learnopengl/animation.h>
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
 #include <stb_image.h>
 
 #include <ft2build.h>
@@ -24,11 +25,246 @@
 #include <random>
 #include <algorithm>
 #include <limits>
+#include <climits>
 #include <array>
 #include <cmath>
 #include <string>
 #include <fstream>
 #include <iomanip>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <functional>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// ===================== Resource Pack =====================
+// Game files (models, textures, audio, fonts) can ship in one pack file with a
+// hashed table of contents. The pack is memory-mapped once at startup and the
+// loaders read straight out of the mapping; anything not in the pack is mapped
+// from its loose file instead. Build it with `RoadRunner --pack`.
+struct MappedFile {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+static bool mapFile(const std::string& path, MappedFile& out)
+{
+#ifdef _WIN32
+    out.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (out.file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(out.file, &size) || size.QuadPart == 0) { CloseHandle(out.file); out.file = INVALID_HANDLE_VALUE; return false; }
+    out.mapping = CreateFileMappingA(out.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!out.mapping) { CloseHandle(out.file); out.file = INVALID_HANDLE_VALUE; return false; }
+    out.data = (const unsigned char*)MapViewOfFile(out.mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!out.data) { CloseHandle(out.mapping); CloseHandle(out.file); out.mapping = nullptr; out.file = INVALID_HANDLE_VALUE; return false; }
+    out.size = (size_t)size.QuadPart;
+    return true;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) { close(fd); return false; }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file alive
+    if (p == MAP_FAILED) return false;
+    out.data = (const unsigned char*)p;
+    out.size = (size_t)st.st_size;
+    return true;
+#endif
+}
+
+static void unmapFile(MappedFile& f)
+{
+    if (!f.data) return;
+#ifdef _WIN32
+    UnmapViewOfFile(f.data);
+    CloseHandle(f.mapping);
+    CloseHandle(f.file);
+    f.mapping = nullptr;
+    f.file = INVALID_HANDLE_VALUE;
+#else
+    munmap((void*)f.data, f.size);
+#endif
+    f.data = nullptr;
+    f.size = 0;
+}
+
+static const char PACK_MAGIC[4] = { 'R', 'R', 'P', 'K' };
+static const uint32_t PACK_VERSION = 1;
+static const char* PACK_FILE = "resources/RoadRunner.rrpak";
+static const std::vector<std::string> PACK_DIRECTORIES = {
+    "resources/objects/RoadRunner", "resources/textures/skybox", "resources/audio", "resources/fonts"
+};
+
+struct PackHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t slotCount;       // power of two, open addressing with linear probing
+    uint64_t slotTableOffset;
+    uint64_t nameTableOffset;
+};
+
+struct PackSlot {
+    uint64_t hash;
+    uint64_t offset;          // file data, 16-byte aligned
+    uint64_t size;
+    uint32_t nameOffset;      // into the name table, for collision checks
+    uint32_t nameLength;      // 0 = empty slot
+};
+
+static MappedFile g_pack;
+
+// pack keys are resource-relative paths with forward slashes
+static std::string normalizeAssetPath(std::string path)
+{
+    std::replace(path.begin(), path.end(), '\\', '/');
+    for (size_t dot; (dot = path.find("/./")) != std::string::npos; ) path.erase(dot, 2);
+    return path;
+}
+
+// pack keys (normalized paths) and shader cache keys
+static uint64_t fnv1a64(const std::string& str)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (char c : str) {
+        h ^= (unsigned char)c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static bool Pack_Open(const std::string& fullPath)
+{
+    if (!mapFile(fullPath, g_pack)) return false;
+    const PackHeader* h = (const PackHeader*)g_pack.data;
+    bool valid = g_pack.size >= sizeof(PackHeader) &&
+        std::memcmp(h->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) == 0 &&
+        h->version == PACK_VERSION &&
+        h->slotCount > 0 && (h->slotCount & (h->slotCount - 1)) == 0 &&
+        h->slotTableOffset <= g_pack.size &&
+        sizeof(PackSlot) * (uint64_t)h->slotCount <= g_pack.size - h->slotTableOffset &&
+        h->nameTableOffset <= g_pack.size;
+    if (!valid) {
+        std::cerr << "Resource pack " << fullPath << " is invalid, using loose files\n";
+        unmapFile(g_pack);
+        return false;
+    }
+    std::cout << "Mapped resource pack (" << h->entryCount << " files)\n";
+    return true;
+}
+
+static void Pack_Close() { unmapFile(g_pack); }
+
+// Look up a file in the pack; `data` points into the mapping (valid until Pack_Close)
+static bool Pack_Find(const std::string& relPath, const unsigned char*& data, size_t& size)
+{
+    if (!g_pack.data) return false;
+    const PackHeader* h = (const PackHeader*)g_pack.data;
+    const PackSlot* slots = (const PackSlot*)(g_pack.data + h->slotTableOffset);
+    const char* names = (const char*)(g_pack.data + h->nameTableOffset);
+    std::string key = normalizeAssetPath(relPath);
+    uint64_t hash = fnv1a64(key);
+    uint32_t mask = h->slotCount - 1;
+    for (uint32_t i = 0; i < h->slotCount; ++i) {
+        const PackSlot& slot = slots[(hash + i) & mask];
+        if (slot.nameLength == 0) return false;
+        if (slot.hash != hash || slot.nameLength != key.size()) continue;
+        if (h->nameTableOffset + slot.nameOffset + slot.nameLength > g_pack.size) return false;
+        if (std::memcmp(names + slot.nameOffset, key.data(), key.size()) != 0) continue;
+        if (slot.offset > g_pack.size || slot.size > g_pack.size - slot.offset) return false;
+        data = g_pack.data + slot.offset;
+        size = (size_t)slot.size;
+        return true;
+    }
+    return false;
+}
+
+// Read-only view of one asset's bytes: inside the pack (no owner) or a loose
+// file mapped on demand (unmapped when the last copy of the blob goes away)
+struct AssetBlob {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    std::shared_ptr<const void> owner; // mapping or heap buffer behind `data`
+};
+
+static bool Assets_Open(const std::string& relPath, AssetBlob& out)
+{
+    out = AssetBlob();
+    if (Pack_Find(relPath, out.data, out.size)) return true;
+
+    std::shared_ptr<MappedFile> file(new MappedFile, [](MappedFile* f) { unmapFile(*f); delete f; });
+    if (!mapFile(FileSystem::getPath(relPath), *file)) return false;
+    out.data = file->data;
+    out.size = file->size;
+    out.owner = file;
+    return true;
+}
+
+// size + mtime of a loose file, used to detect stale derived files (.rrmesh, .rranim, .rrtex)
+static bool sourceStamp(const std::string& path, uint64_t& size, int64_t& time)
+{
+    std::error_code ec;
+    size = (uint64_t)std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    time = (int64_t)std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+    return !ec;
+}
+
+// Write a whole file under a temporary name, then rename it over `path`:
+// readers that mapped the old file keep its pages, and nobody ever sees a
+// partial file. The temporary name is unique per thread so two writers of the
+// same path don't share it; if the rename loses (e.g. the target is mapped on
+// Windows), the old file stays.
+static bool writeFileReplacing(const std::string& path, const void* data, size_t size)
+{
+    std::string tmpPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write((const char*)data, (std::streamsize)size);
+        if (!out) { out.close(); std::remove(tmpPath.c_str()); return false; }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (!ec) return true;
+    std::filesystem::remove(tmpPath, ec);
+    return false;
+}
+
+static bool Assets_Exists(const std::string& relPath)
+{
+    const unsigned char* data; size_t size;
+    if (Pack_Find(relPath, data, size)) return true;
+    std::error_code ec;
+    return std::filesystem::is_regular_file(FileSystem::getPath(relPath), ec);
+}
 
 // --- irrKlang audio ---
 #include <irrKlang/irrKlang.h>
@@ -36,151 +272,479 @@ using namespace irrklang;
 
 #include <vector>
 
+// All irrKlang calls run on one audio thread, which owns the engine, the sound
+// sources and every ISound handle. The game only posts fire-and-forget events
+// ("jump", "slide start", "run loop"...) into a lock-free single-producer /
+// single-consumer ring (main thread -> audio thread); the thread drains it
+// every AUDIO_THREAD_PERIOD and recycles finished voices, so no device call is
+// on the frame's path. The run/slide loop isn't an event but a state the thread
+// catches up with every tick (g_audioLoop), so a full queue can't leave a loop
+// playing or silent; only one-shots are lost then, and g_audioDropped counts them.
+enum AudioEvent : uint8_t {
+    AUDIO_LOAD,           // register the sources named by Audio_LoadFiles
+    AUDIO_AMBIENCE_START,
+    AUDIO_CLICK,
+    AUDIO_JUMP,
+    AUDIO_FAIL,
+};
+
+struct AudioCommand {
+    AudioEvent event;
+};
+
+static const uint32_t AUDIO_QUEUE_SIZE = 256; // power of two
+static const std::chrono::milliseconds AUDIO_THREAD_PERIOD(2);
+
+struct AudioQueue {
+    AudioCommand items[AUDIO_QUEUE_SIZE];
+    alignas(64) std::atomic<uint32_t> head{ 0 };  // next write, main thread
+    alignas(64) std::atomic<uint32_t> tail{ 0 };  // next read, audio thread
+};
+
+enum AudioLoop : uint8_t { AUDIO_LOOP_NONE, AUDIO_LOOP_RUN, AUDIO_LOOP_SLIDE };
+
+static AudioQueue g_audioQueue;
+static std::thread g_audioThread;
+static std::atomic<bool> g_audioQuit{ false };
+static std::atomic<uint8_t> g_audioLoop{ AUDIO_LOOP_NONE }; // written by the main thread only
+static uint32_t g_audioDropped = 0;                         // main thread, shown with F3
+
+// main thread; a full queue drops the event (the thread is stuck, not worth a stall)
+static void Audio_Post(AudioEvent event)
+{
+    if (!g_audioThread.joinable()) return;
+    AudioQueue& q = g_audioQueue;
+    uint32_t head = q.head.load(std::memory_order_relaxed);
+    if (head - q.tail.load(std::memory_order_acquire) == AUDIO_QUEUE_SIZE) { ++g_audioDropped; return; }
+    q.items[head & (AUDIO_QUEUE_SIZE - 1)] = { event };
+    q.head.store(head + 1, std::memory_order_release);
+}
+
+// audio thread
+static bool Audio_Pop(AudioCommand& out)
+{
+    AudioQueue& q = g_audioQueue;
+    uint32_t tail = q.tail.load(std::memory_order_relaxed);
+    if (tail == q.head.load(std::memory_order_acquire)) return false;
+    out = q.items[tail & (AUDIO_QUEUE_SIZE - 1)];
+    q.tail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+// ---- everything below up to the public API runs on the audio thread ----
 static ISoundEngine* g_audioEngine = nullptr;
 static ISound* g_ambience = nullptr;
 static ISound* g_slide = nullptr;
 static ISound* g_running = nullptr;
 
-// track short one-shot sounds so we can drop them cleanly after they finish
-static std::vector<ISound*> g_trackedOneShots;
+// Every sound is registered once as a sound source (AUDIO_LOAD): short
+// effects decoded up front, the long loops streamed. Nothing touches the disk
+// after that.
+enum AudioSound {
+    SOUND_AMBIENCE, SOUND_CLICK, SOUND_JUMP, SOUND_SLIDE, SOUND_RUNNING, SOUND_FAIL, SOUND_ENGINE, SOUND_HORN, SOUND_COUNT
+};
+
+struct SoundDesc {
+    float volume;
+    bool  stream;       // decode while playing instead of up front
+    int   priority;     // one-shots: higher steals lower when all voices are busy
+    int   maxVoices;    // one-shots: instances at once, the oldest is restarted past this
+    float minDistance;  // 3D: full volume up to here, then rolls off; 0 = 2D only
+};
+
+static const SoundDesc SOUND_DESCS[SOUND_COUNT] = {
+    { 0.7f, true,  0, 0, 0.0f },   // ambience (loop)
+    { 1.0f, false, 2, 2, 0.0f },   // click
+    { 1.0f, false, 1, 2, 0.0f },   // jump
+    { 1.0f, true,  0, 0, 0.0f },   // slide (loop)
+    { 0.9f, true,  0, 0, 0.0f },   // running (loop)
+    { 1.0f, false, 3, 1, 0.0f },   // fail
+    { 0.6f, false, 0, 0, 10.0f },  // car engine (3D loop, see Traffic)
+    { 0.8f, false, 1, 2, 15.0f },  // car horn (3D)
+};
+
+static ISoundSource* g_soundSources[SOUND_COUNT] = {};
+
+// One-shots play from a fixed pool of voices, live ones packed at the front:
+// finished voices are swap-removed, and a full pool steals (see Audio_PlayOneShot)
+static const int AUDIO_VOICE_COUNT = 8;
+
+struct Voice {
+    ISound*    sound = nullptr;
+    AudioSound id = SOUND_CLICK;
+    uint32_t   serial = 0;          // start order, lower = older
+};
 
-static std::string g_ambiencePath, g_clickPath, g_jumpPath, g_slidePath, g_runningPath, g_failPath;
+static Voice g_voices[AUDIO_VOICE_COUNT];
+static int g_voiceCount = 0;
+static uint32_t g_voiceSerial = 0;
 
-static bool Audio_Init()
+// finished voices go back to the pool
+static void Audio_RecycleVoices()
 {
-    if (g_audioEngine) return true;
-    g_audioEngine = createIrrKlangDevice();
-    if (!g_audioEngine) {
-        std::cerr << "Audio: failed to create irrKlang device\n";
+    for (int i = 0; i < g_voiceCount;) {
+        if (g_voices[i].sound->isFinished()) {
+            g_voices[i].sound->drop();
+            g_voices[i] = g_voices[--g_voiceCount];
+        }
+        else {
+            ++i;
+        }
+    }
+}
+
+// 16-bit mono PCM in a WAV container, for addSoundSourceFromMemory
+static std::vector<unsigned char> makeWav(const std::vector<int16_t>& samples, uint32_t rate)
+{
+    std::vector<unsigned char> wav(44 + samples.size() * 2);
+    auto put32 = [&](size_t at, uint32_t v) { for (int i = 0; i < 4; ++i) wav[at + i] = (unsigned char)(v >> (8 * i)); };
+    auto put16 = [&](size_t at, uint16_t v) { wav[at] = (unsigned char)v; wav[at + 1] = (unsigned char)(v >> 8); };
+    std::memcpy(&wav[0], "RIFF", 4);
+    put32(4, (uint32_t)wav.size() - 8);
+    std::memcpy(&wav[8], "WAVEfmt ", 8);
+    put32(16, 16);
+    put16(20, 1);            // PCM
+    put16(22, 1);            // mono
+    put32(24, rate);
+    put32(28, rate * 2);
+    put16(32, 2);
+    put16(34, 16);
+    std::memcpy(&wav[36], "data", 4);
+    put32(40, (uint32_t)samples.size() * 2);
+    std::memcpy(&wav[44], samples.data(), samples.size() * 2);
+    return wav;
+}
+
+// Built-in stand-ins for the traffic sounds, used when the game's resources
+// don't ship them: a one-second engine hum whose partials all complete whole
+// cycles (so it loops without a click) and a two-tone horn
+static bool Audio_SynthesizeClip(AudioSound id, std::vector<unsigned char>& wav)
+{
+    const uint32_t rate = 22050;
+    const float twoPi = 6.2831853f;
+    std::vector<int16_t> samples;
+    if (id == SOUND_ENGINE) {
+        samples.resize(rate);
+        for (uint32_t i = 0; i < rate; ++i) {
+            float t = (float)i / rate;
+            float pulse = 0.75f + 0.25f * std::sin(twoPi * 25.0f * t);   // firing rate
+            float hum = 0.6f * std::sin(twoPi * 50.0f * t) + 0.3f * std::sin(twoPi * 100.0f * t) + 0.1f * std::sin(twoPi * 150.0f * t);
+            samples[i] = (int16_t)(hum * pulse * 0.8f * 32767.0f);
+        }
+    }
+    else if (id == SOUND_HORN) {
+        samples.resize(rate * 6 / 10);
+        for (size_t i = 0; i < samples.size(); ++i) {
+            float t = (float)i / rate;
+            float envelope = std::min(1.0f, std::min(t, (float)samples.size() / rate - t) / 0.02f);
+            float tone = std::tanh(3.0f * std::sin(twoPi * 410.0f * t)) + std::tanh(3.0f * std::sin(twoPi * 510.0f * t));
+            samples[i] = (int16_t)(tone * 0.4f * envelope * 32767.0f);
+        }
+    }
+    else {
         return false;
     }
+    wav = makeWav(samples, rate);
     return true;
 }
 
-static void Audio_Shutdown()
+// Sounds found in the resource pack are registered straight from the mapping
+// (irrKlang doesn't copy them), others from their loose file; a missing file
+// falls back to Audio_SynthesizeClip where there is one
+static ISoundSource* Audio_RegisterSource(AudioSound id, const std::string& relPath)
 {
-    // stop & drop looped sounds
-    if (g_ambience) { g_ambience->stop(); g_ambience->drop(); g_ambience = nullptr; }
-    if (g_slide)   { g_slide->stop();   g_slide->drop();   g_slide = nullptr; }
-    if (g_running) { g_running->stop(); g_running->drop(); g_running = nullptr; }
-
-    // ensure any tracked one-shots are stopped/dropped
-    for (ISound* s : g_trackedOneShots) {
-        if (s) { s->stop(); s->drop(); }
+    if (!g_audioEngine) return nullptr;
+    const SoundDesc& desc = SOUND_DESCS[id];
+    E_STREAM_MODE mode = desc.stream ? ESM_STREAMING : ESM_NO_STREAMING;
+    ISoundSource* source = nullptr;
+    const unsigned char* data; size_t size;
+    std::vector<unsigned char> wav;
+    if (Pack_Find(relPath, data, size)) {
+        source = g_audioEngine->addSoundSourceFromMemory((void*)data, (ik_s32)size, relPath.c_str(), false);
+        if (source) source->setStreamMode(mode);
+    }
+    else if (!Assets_Exists(relPath) && Audio_SynthesizeClip(id, wav)) {
+        source = g_audioEngine->addSoundSourceFromMemory(wav.data(), (ik_s32)wav.size(), relPath.c_str(), true);
+    }
+    if (!source) source = g_audioEngine->addSoundSourceFromFile(FileSystem::getPath(relPath).c_str(), mode, !desc.stream);
+    if (!source) {
+        std::cerr << "Audio: failed to load " << relPath << "\n";
+        return nullptr;
     }
-    g_trackedOneShots.clear();
+    source->setDefaultVolume(desc.volume);
+    if (desc.minDistance > 0.0f) source->setDefaultMinDistance(desc.minDistance);
+    return source;
+}
 
-    if (g_audioEngine) { g_audioEngine->drop(); g_audioEngine = nullptr; }
+static std::string g_audioFiles[SOUND_COUNT]; // written before AUDIO_LOAD is posted, read after it's popped
+
+static void Audio_LoadSources()
+{
+    for (int i = 0; i < SOUND_COUNT; ++i) g_soundSources[i] = Audio_RegisterSource((AudioSound)i, g_audioFiles[i]);
 }
 
-// call this once per frame from the main loop to clean up finished one-shot sounds
-static void Audio_Update()
+// Play a one-shot on a free voice, in 3D when `at` is given. Past the sound's
+// maxVoices its oldest instance is cut; with every voice busy the oldest of the
+// lowest priority goes, unless all of them outrank this sound, which is then skipped.
+static void Audio_PlayOneShot(AudioSound id, const vec3df* at = nullptr)
 {
-    if (g_trackedOneShots.empty()) return;
-    // remove finished sounds (drop them)
-    auto it = g_trackedOneShots.begin();
-    while (it != g_trackedOneShots.end()) {
-        ISound* s = *it;
-        if (!s) { it = g_trackedOneShots.erase(it); continue; }
-        // isFinished() returns true once playback ended
-        if (s->isFinished()) {
-            s->drop();           // release the reference
-            it = g_trackedOneShots.erase(it);
-        } else {
-            ++it;
+    if (!g_audioEngine || !g_soundSources[id]) return;
+    const SoundDesc& desc = SOUND_DESCS[id];
+    int instances = 0, oldestSame = -1, victim = -1;
+    for (int i = 0; i < g_voiceCount; ++i) {
+        const Voice& v = g_voices[i];
+        if (v.id == id) {
+            ++instances;
+            if (oldestSame < 0 || v.serial < g_voices[oldestSame].serial) oldestSame = i;
         }
+        int p = SOUND_DESCS[v.id].priority;
+        if (victim < 0 || p < SOUND_DESCS[g_voices[victim].id].priority ||
+            (p == SOUND_DESCS[g_voices[victim].id].priority && v.serial < g_voices[victim].serial)) victim = i;
     }
+
+    int slot = g_voiceCount;
+    if (instances >= desc.maxVoices) slot = oldestSame;
+    else if (g_voiceCount == AUDIO_VOICE_COUNT) {
+        if (SOUND_DESCS[g_voices[victim].id].priority > desc.priority) return;
+        slot = victim;
+    }
+
+    ISound* s = at ? g_audioEngine->play3D(g_soundSources[id], *at, false, false, true)
+                   : g_audioEngine->play2D(g_soundSources[id], false, false, true);
+    if (!s) return;
+    if (slot < g_voiceCount) {
+        g_voices[slot].sound->stop();
+        g_voices[slot].sound->drop();
+    }
+    else {
+        ++g_voiceCount;
+    }
+    g_voices[slot].sound = s;
+    g_voices[slot].id = id;
+    g_voices[slot].serial = g_voiceSerial++;
 }
 
-static void Audio_LoadFiles(const std::string& ambience,
-                            const std::string& click,
-                            const std::string& jump,
-                            const std::string& slide,
-                            const std::string& running,
-                            const std::string& fail)
+static ISound* Audio_PlayLoop(AudioSound id)
 {
-    // store paths; call Audio_Init() before load/play
-    g_ambiencePath = ambience;
-    g_clickPath = click;
-    g_jumpPath = jump;
-    g_slidePath = slide;
-    g_runningPath = running;
-    g_failPath = fail;
+    if (!g_audioEngine || !g_soundSources[id]) return nullptr;
+    return g_audioEngine->play2D(g_soundSources[id], true, false, true);
 }
 
-static void Audio_PlayAmbienceLoop()
+// Traffic: every car near the player is a virtual source (id, position
+// relative to the camera); only the AUDIO_TRAFFIC_VOICES nearest within
+// AUDIO_TRAFFIC_RANGE hold a playing engine loop, the rest are silent until
+// they get close enough to win a voice back. However dense the traffic, mixing
+// stays bounded. A car honks once, the first time it comes within
+// AUDIO_HORN_DISTANCE ahead while it has a voice.
+// The car list doesn't go through the event queue: Audio_PostTraffic writes a
+// whole snapshot each frame into a triple buffer and the thread picks up the
+// latest one, so traffic never crowds out gameplay events and a slow tick
+// just skips stale lists.
+static const int   AUDIO_TRAFFIC_SOURCES = 32;  // virtual cars tracked, extra ones are ignored
+static const int   AUDIO_TRAFFIC_VOICES = 4;    // of which audible at once
+static const float AUDIO_TRAFFIC_RANGE = 150.0f;
+static const float AUDIO_HORN_DISTANCE = 40.0f;
+
+struct TrafficSnapshot {
+    float front[3];             // camera front
+    int   count = 0;
+    struct { uint32_t id; float pos[3]; } cars[AUDIO_TRAFFIC_SOURCES]; // relative to the camera
+};
+
+// The main thread fills slot g_trafficBack and swaps it into g_trafficLatest
+// (flagged new); the audio thread swaps a new latest for its g_trafficFront.
+static const uint8_t AUDIO_SNAPSHOT_NEW = 4;
+static TrafficSnapshot g_trafficSnapshots[3];
+static std::atomic<uint8_t> g_trafficLatest{ 1 };
+static uint8_t g_trafficBack = 0;   // main thread
+static uint8_t g_trafficFront = 2;  // audio thread
+
+struct TrafficSource {
+    uint32_t id = 0;
+    vec3df   pos;               // relative to the listener
+    float    distance = 0.0f;
+    ISound*  engine = nullptr;  // null while virtual
+    bool     seen = false;      // listed in the current update
+    bool     honked = false;
+};
+
+static TrafficSource g_traffic[AUDIO_TRAFFIC_SOURCES];
+static int g_trafficCount = 0;
+static vec3df g_listenerFront(1.0f, 0.0f, 0.0f);
+
+static void Audio_TrafficCar(uint32_t id, const vec3df& pos)
 {
-    if (!g_audioEngine || g_ambiencePath.empty()) return;
-    if (g_ambience) return; // already playing
-    g_ambience = g_audioEngine->play2D(g_ambiencePath.c_str(), true, false, true);
-    if (g_ambience) g_ambience->setVolume(0.7f);
+    TrafficSource* src = nullptr;
+    for (int i = 0; i < g_trafficCount && !src; ++i)
+        if (g_traffic[i].id == id) src = &g_traffic[i];
+    if (!src) {
+        if (g_trafficCount == AUDIO_TRAFFIC_SOURCES) return;
+        src = &g_traffic[g_trafficCount++];
+        *src = TrafficSource();
+        src->id = id;
+    }
+    src->pos = pos;
+    src->distance = (float)pos.getLength();
+    src->seen = true;
 }
 
-static void Audio_PlayClick()
+static void Audio_TrafficVirtualize()
 {
-    if (!g_audioEngine || g_clickPath.empty()) return;
-    // track the one-shot so we can drop it cleanly when finished
-    ISound* s = g_audioEngine->play2D(g_clickPath.c_str(), false, false, true);
-    if (s) {
-        s->setVolume(1.0f);
-        g_trackedOneShots.push_back(s);
+    // gone since the last update: swap-remove
+    for (int i = 0; i < g_trafficCount;) {
+        TrafficSource& t = g_traffic[i];
+        if (t.seen) { ++i; continue; }
+        if (t.engine) { t.engine->stop(); t.engine->drop(); }
+        t = g_traffic[--g_trafficCount];
+    }
+
+    int order[AUDIO_TRAFFIC_SOURCES];
+    for (int i = 0; i < g_trafficCount; ++i) order[i] = i;
+    std::sort(order, order + g_trafficCount, [](int a, int b) { return g_traffic[a].distance < g_traffic[b].distance; });
+
+    for (int rank = 0; rank < g_trafficCount; ++rank) {
+        TrafficSource& t = g_traffic[order[rank]];
+        t.seen = false;
+        bool audible = rank < AUDIO_TRAFFIC_VOICES && t.distance < AUDIO_TRAFFIC_RANGE;
+        if (!audible) {
+            if (t.engine) { t.engine->stop(); t.engine->drop(); t.engine = nullptr; }
+            continue;
+        }
+        if (!t.engine && g_soundSources[SOUND_ENGINE])
+            t.engine = g_audioEngine->play3D(g_soundSources[SOUND_ENGINE], t.pos, true, false, true);
+        if (t.engine) t.engine->setPosition(t.pos);
+        if (!t.honked && t.distance < AUDIO_HORN_DISTANCE && t.pos.dotProduct(g_listenerFront) > 0.0f) {
+            t.honked = true;
+            Audio_PlayOneShot(SOUND_HORN, &t.pos);
+        }
     }
 }
 
-static void Audio_PlayJump()
+// take the latest traffic snapshot, if there's a new one
+static void Audio_UpdateTraffic()
+{
+    if (!(g_trafficLatest.load(std::memory_order_relaxed) & AUDIO_SNAPSHOT_NEW)) return;
+    g_trafficFront = g_trafficLatest.exchange(g_trafficFront, std::memory_order_acq_rel) & 3;
+    const TrafficSnapshot& snap = g_trafficSnapshots[g_trafficFront];
+    g_listenerFront = vec3df(snap.front[0], snap.front[1], snap.front[2]);
+    g_audioEngine->setListenerPosition(vec3df(0.0f, 0.0f, 0.0f), g_listenerFront);
+    for (int i = 0; i < snap.count; ++i)
+        Audio_TrafficCar(snap.cars[i].id, vec3df(snap.cars[i].pos[0], snap.cars[i].pos[1], snap.cars[i].pos[2]));
+    Audio_TrafficVirtualize();
+}
+
+static void Audio_Execute(const AudioCommand& cmd)
 {
-    if (!g_audioEngine || g_jumpPath.empty()) return;
-    ISound* s = g_audioEngine->play2D(g_jumpPath.c_str(), false, false, true);
-    if (s) {
-        s->setVolume(1.0f);
-        g_trackedOneShots.push_back(s);
+    switch (cmd.event) {
+    case AUDIO_LOAD:
+        Audio_LoadSources();
+        break;
+    case AUDIO_AMBIENCE_START:
+        if (!g_ambience) g_ambience = Audio_PlayLoop(SOUND_AMBIENCE);
+        break;
+    case AUDIO_CLICK: Audio_PlayOneShot(SOUND_CLICK); break;
+    case AUDIO_JUMP:  Audio_PlayOneShot(SOUND_JUMP); break;
+    case AUDIO_FAIL:  Audio_PlayOneShot(SOUND_FAIL); break;
     }
 }
 
-static void Audio_PlaySlideLoop()
+// bring the run/slide loops in line with g_audioLoop: at most one of them plays
+static void Audio_ApplyLoop(uint8_t loop)
+{
+    if (loop != AUDIO_LOOP_SLIDE && g_slide) { g_slide->stop(); g_slide->drop(); g_slide = nullptr; }
+    if (loop != AUDIO_LOOP_RUN && g_running) { g_running->stop(); g_running->drop(); g_running = nullptr; }
+    if (loop == AUDIO_LOOP_SLIDE && !g_slide) g_slide = Audio_PlayLoop(SOUND_SLIDE);
+    if (loop == AUDIO_LOOP_RUN && !g_running) g_running = Audio_PlayLoop(SOUND_RUNNING);
+}
+
+static void Audio_ThreadMain()
 {
-    if (!g_audioEngine || g_slidePath.empty()) return;
-    // stop running if playing
+    g_audioEngine = createIrrKlangDevice();
+    if (!g_audioEngine) std::cerr << "Audio: failed to create irrKlang device\n";
+
+    for (;;) {
+        // read first: everything posted before Audio_Shutdown still plays out
+        bool quit = g_audioQuit.load(std::memory_order_acquire);
+        AudioCommand cmd;
+        while (Audio_Pop(cmd)) {
+            if (g_audioEngine) Audio_Execute(cmd);
+        }
+        if (g_audioEngine) {
+            Audio_ApplyLoop(g_audioLoop.load(std::memory_order_acquire));
+            Audio_UpdateTraffic();
+        }
+        Audio_RecycleVoices();
+        if (quit) break;
+        std::this_thread::sleep_for(AUDIO_THREAD_PERIOD);
+    }
+
+    // stop & drop looped sounds
+    if (g_ambience) { g_ambience->stop(); g_ambience->drop(); g_ambience = nullptr; }
+    if (g_slide)   { g_slide->stop();   g_slide->drop();   g_slide = nullptr; }
     if (g_running) { g_running->stop(); g_running->drop(); g_running = nullptr; }
-    if (!g_slide) {
-        g_slide = g_audioEngine->play2D(g_slidePath.c_str(), true, false, true);
-        if (g_slide) g_slide->setVolume(1.0f);
-    } else {
-        g_slide->setIsPaused(false);
+
+    for (int i = 0; i < g_trafficCount; ++i) {
+        if (g_traffic[i].engine) { g_traffic[i].engine->stop(); g_traffic[i].engine->drop(); }
+    }
+    g_trafficCount = 0;
+
+    // ensure any playing one-shots are stopped/dropped
+    for (int i = 0; i < g_voiceCount; ++i) {
+        g_voices[i].sound->stop();
+        g_voices[i].sound->drop();
     }
+    g_voiceCount = 0;
+
+    // sound sources belong to the engine
+    if (g_audioEngine) { g_audioEngine->drop(); g_audioEngine = nullptr; }
+    std::fill(std::begin(g_soundSources), std::end(g_soundSources), nullptr);
 }
 
-static void Audio_StopSlide()
+// ---- public API, main thread ----
+static void Audio_Init()
 {
-    if (g_slide) { g_slide->stop(); g_slide->drop(); g_slide = nullptr; }
+    if (g_audioThread.joinable()) return;
+    g_audioQuit = false;
+    g_audioThread = std::thread(Audio_ThreadMain);
 }
 
-static void Audio_PlayRunningLoop()
+static void Audio_Shutdown()
 {
-    if (!g_audioEngine || g_runningPath.empty()) return;
-    // stop slide if playing
-    if (g_slide) { g_slide->stop(); g_slide->drop(); g_slide = nullptr; }
-    if (!g_running) {
-        g_running = g_audioEngine->play2D(g_runningPath.c_str(), true, false, true);
-        if (g_running) g_running->setVolume(0.9f);
-    } else {
-        g_running->setIsPaused(false);
-    }
+    if (!g_audioThread.joinable()) return;
+    g_audioQuit.store(true, std::memory_order_release);
+    g_audioThread.join();
+    if (g_audioDropped) std::cerr << "Audio: " << g_audioDropped << " events dropped on a full queue\n";
 }
 
-static void Audio_StopRunning()
+// takes resource-relative paths (e.g. "resources/audio/jump.wav"); call Audio_Init() first
+static void Audio_LoadFiles(const std::string& ambience,
+                            const std::string& click,
+                            const std::string& jump,
+                            const std::string& slide,
+                            const std::string& running,
+                            const std::string& fail,
+                            const std::string& engine,
+                            const std::string& horn)
 {
-    if (g_running) { g_running->stop(); g_running->drop(); g_running = nullptr; }
+    const std::string* paths[SOUND_COUNT] = { &ambience, &click, &jump, &slide, &running, &fail, &engine, &horn };
+    for (int i = 0; i < SOUND_COUNT; ++i) g_audioFiles[i] = *paths[i];
+    Audio_Post(AUDIO_LOAD);
 }
 
-static void Audio_PlayFail()
+static void Audio_PlayAmbienceLoop() { Audio_Post(AUDIO_AMBIENCE_START); }
+static void Audio_PlayClick() { Audio_Post(AUDIO_CLICK); }
+static void Audio_PlayJump() { Audio_Post(AUDIO_JUMP); }
+static void Audio_PlayFail() { Audio_Post(AUDIO_FAIL); }
+// slide and run replace each other; a stop only ends its own loop
+static void Audio_PlaySlideLoop() { g_audioLoop.store(AUDIO_LOOP_SLIDE, std::memory_order_release); }
+static void Audio_StopSlide()
 {
-    if (!g_audioEngine || g_failPath.empty()) return;
-    ISound* s = g_audioEngine->play2D(g_failPath.c_str(), false, false, true);
-    if (s) {
-        s->setVolume(1.0f);
-        g_trackedOneShots.push_back(s);
-    }
+    if (g_audioLoop.load(std::memory_order_relaxed) == AUDIO_LOOP_SLIDE) g_audioLoop.store(AUDIO_LOOP_NONE, std::memory_order_release);
+}
+static void Audio_PlayRunningLoop() { g_audioLoop.store(AUDIO_LOOP_RUN, std::memory_order_release); }
+static void Audio_StopRunning()
+{
+    if (g_audioLoop.load(std::memory_order_relaxed) == AUDIO_LOOP_RUN) g_audioLoop.store(AUDIO_LOOP_NONE, std::memory_order_release);
 }
 // --- end irrKlang audio ---
 
@@ -198,7 +762,6 @@ enum class GameState {
 };
 
 static GameState currentGameState = GameState::START_SCREEN;
-static bool startKeyPressed = false;
 
 // UI Button struct
 struct Button {
@@ -237,288 +800,4389 @@ static double mouseX = 0.0;
 static double mouseY = 0.0;
 static bool mouseButtonPressed = false;
 
-// ===================== Text Rendering =====================
-struct Character {
-    unsigned int TextureID; // ID handle of the glyph texture
-    glm::ivec2   Size;      // Size of glyph
-    glm::ivec2   Bearing;   // Offset from baseline to left/top of glyph
-    unsigned int Advance;   // Horizontal offset to advance to next glyph
+// ===================== Frame Profiler =====================
+// Per-frame counters, shown on the HUD with F3. Counters for the frame in
+// progress are in g_frameStats; the overlay shows the last finished frame.
+struct FrameStats {
+    float    frameMs = 0.0f;
+    uint32_t drawCalls = 0;     // issued by RenderQueue_Flush
+    uint32_t stateCalls = 0;    // GL state changes issued through GLState_*
+    uint32_t avoidedCalls = 0;  // redundant ones the state cache skipped
+    uint32_t occlusionTested = 0; // occlusion queries issued
+    uint32_t occlusionCulled = 0; // objects left out of the scene pass as hidden
+    float    gpuMs = 0.0f;        // world pass GPU time (see Dynamic Resolution)
+    float    renderScale = 1.0f;  // scene resolution / window resolution
+    float    waitMs = 0.0f;       // slept by the frame cap (see Frame Pacing)
+    float    inputMs = 0.0f;      // key press to presented reaction, recent average (see Input Events)
+    float    inputWorstMs = 0.0f; // and worst
 };
 
-static std::map<GLchar, Character> Characters;
-static GLuint textVAO, textVBO;
-static Shader* textShader = nullptr;
+static FrameStats g_frameStats;
+static FrameStats g_lastFrameStats;
+static double g_frameStartTime = 0.0;
+static bool g_profilerOverlay = false;
 
-// Player Config
+// top of the main loop: close the previous frame's counters
+static void Profiler_NewFrame()
+{
+    double now = glfwGetTime();
+    if (g_frameStartTime > 0.0) {
+        g_frameStats.frameMs = (float)((now - g_frameStartTime) * 1000.0);
+        g_lastFrameStats = g_frameStats;
+    }
+    g_frameStats = FrameStats();
+    g_frameStartTime = now;
+}
 
-// Player Config
-static const float PLAYER_SCALE = 3.75f;
-static const float PLAYER_RADIUS = 1.0f * PLAYER_SCALE;
-static const float PLAYER_SPAWN_HEIGHT = 1.0f;
+// two overlay lines: timings, then counters
+static std::string Profiler_Summary(int line)
+{
+    const FrameStats& f = g_lastFrameStats;
+    char text[200];
+    if (line == 0)
+        std::snprintf(text, sizeof(text), "%.2f ms  wait %.2f ms  gpu %.2f ms @ %d%%  input %.1f ms (worst %.1f)",
+                      f.frameMs, f.waitMs, f.gpuMs, (int)(f.renderScale * 100.0f + 0.5f), f.inputMs, f.inputWorstMs);
+    else
+        std::snprintf(text, sizeof(text), "draws %u  state calls %u  avoided %u  occluded %u  tested %u  audio dropped %u",
+                      f.drawCalls, f.stateCalls, f.avoidedCalls, f.occlusionCulled, f.occlusionTested, g_audioDropped);
+    return text;
+}
 
-// Camera Config
-static const float CAM_DISTANCE = 25.0f;
-static const float CAM_HEIGHT = 10.0f;
-static const float CAM_SMOOTHING = 5.0f;  // Camera smoothing factor (higher = faster follow)
+// ===================== GL State Cache =====================
+// Shadow copy of the GL state the renderer switches most: program, VAO, the
+// GL_ARRAY_BUFFER binding, texture bindings per unit and blend/depth state.
+// Calls that wouldn't change anything are skipped (and counted). Everything in
+// this file binds through these, so the copy stays exact; other targets and
+// units (e.g. GL_ELEMENT_ARRAY_BUFFER, which is VAO state) are passed through.
+static const int GLSTATE_TEXTURE_UNITS = 16;
+static const GLuint GLSTATE_UNKNOWN = 0xFFFFFFFFu;
+
+struct GLStateCache {
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLuint arrayBuffer = 0;
+    GLenum activeTexture = GL_TEXTURE0;
+    GLuint textures[GLSTATE_TEXTURE_UNITS][3] = {};    // 2D, 2D array, cube map
+    GLuint depthTest = GLSTATE_UNKNOWN, blend = GLSTATE_UNKNOWN;
+    GLenum blendSrc = GLSTATE_UNKNOWN, blendDst = GLSTATE_UNKNOWN;
+    GLenum depthFunc = GLSTATE_UNKNOWN;
+};
 
-// Scene Config
-static const float LANE_Z_SPACING = 15.0f;   // z offset between lanes
-static const float SIDEWALK_WIDTH = 12.0f;   // extra width on each side of the road for buildings
-static const int   LANE_COUNT = 3;
-static const float SECTION_LENGTH = 64.0f;  // length of a road section (equal to 2 buildings)
-static const float BUILDING_LENGTH = SECTION_LENGTH / 2.0f;
+static GLStateCache g_glState;
 
-static const float PLAYER_FORWARD_SPEED = 30.0f; // automatic forward speed (units/sec) along +X
-static const float LANE_SWITCH_COOLDOWN = 0.18f; // seconds between lane changes
+static bool GLState_Changed(GLuint& cached, GLuint value)
+{
+    if (cached == value) { ++g_frameStats.avoidedCalls; return false; }
+    cached = value;
+    ++g_frameStats.stateCalls;
+    return true;
+}
 
-// Obstacle spawn chances (per lane per section)
-static float PROB_CAR = 0.25f;
-static float PROB_JUMP = 0.20f;
-static float PROB_SLIDE = 0.20f;
-static float PROB_WIRES = 0.08f; // special case; if wires spawn, only middle lane spawns them (they cross all lanes)
+static void GLState_UseProgram(GLuint program)
+{
+    if (GLState_Changed(g_glState.program, program)) glUseProgram(program);
+}
 
-// Collision threshold along forward axis (X)
-static const float OBSTACLE_HIT_AXIS_RADIUS = 1.2f; // distance along X to consider collision
-static const float OBSTACLE_RENDER_HEIGHT = 0.0f;
+static void GLState_BindVertexArray(GLuint vao)
+{
+    if (GLState_Changed(g_glState.vertexArray, vao)) glBindVertexArray(vao);
+}
 
-// Crouch render height (when holding S)
-static const float PLAYER_CROUCH_HEIGHT = 0.0f;
+static void GLState_BindBuffer(GLenum target, GLuint buffer)
+{
+    if (target != GL_ARRAY_BUFFER) { glBindBuffer(target, buffer); return; }
+    if (GLState_Changed(g_glState.arrayBuffer, buffer)) glBindBuffer(target, buffer);
+}
 
-// Animation states
-enum AnimState {
-    RUNNING,
-    RUNNING_JUMP,
-    JUMP,
-    JUMP_RUNNING,
-    RUNNING_SLIDE,
-    SLIDE,
-    SLIDE_RUNNING,
-    RUNNING_SIDESTEP_LEFT,
-    SIDESTEP_LEFT,
-    SIDESTEP_LEFT_RUNNING,
-    RUNNING_SIDESTEP_RIGHT,
-    SIDESTEP_RIGHT,
-    SIDESTEP_RIGHT_RUNNING
-};
+// GL unbinds deleted buffers; keep the cache from skipping a later bind of a recycled name
+static void GLState_DeleteBuffers(GLsizei n, const GLuint* buffers)
+{
+    for (GLsizei i = 0; i < n; ++i)
+        if (g_glState.arrayBuffer == buffers[i]) g_glState.arrayBuffer = 0;
+    glDeleteBuffers(n, buffers);
+}
 
-// ===================== State & Helpers =====================
-Camera camera(glm::vec3(0.0f, 2.0f, 8.0f));
-float deltaTime = 0.f, lastFrame = 0.f;
+// same for textures, on every unit they were bound to
+static void GLState_DeleteTextures(GLsizei n, const GLuint* textures)
+{
+    for (GLsizei i = 0; i < n; ++i)
+        for (auto& unit : g_glState.textures)
+            for (GLuint& bound : unit)
+                if (bound == textures[i]) bound = 0;
+    glDeleteTextures(n, textures);
+}
 
-// Camera smoothing
-static glm::vec3 cameraTargetPos = glm::vec3(0.0f, CAM_HEIGHT, -CAM_DISTANCE);
+static void GLState_ActiveTexture(GLenum unit)
+{
+    if (GLState_Changed(g_glState.activeTexture, unit)) glActiveTexture(unit);
+}
 
-static bool debugCameraEnabled = false;
-static bool debugTogglePressed = false;
-static float debugYaw = -90.0f;
-static float debugPitch = 0.0f;
-static const float DEBUG_CAM_SPEED = 40.0f;      // units / second
-static const float DEBUG_CAM_TURN_SPEED = 90.0f; // degrees / second
+static void GLState_BindTexture(GLenum target, GLuint texture)
+{
+    int unit = (int)(g_glState.activeTexture - GL_TEXTURE0);
+    int slot = target == GL_TEXTURE_2D ? 0 : target == GL_TEXTURE_2D_ARRAY ? 1 : target == GL_TEXTURE_CUBE_MAP ? 2 : -1;
+    if (unit < 0 || unit >= GLSTATE_TEXTURE_UNITS || slot < 0) { glBindTexture(target, texture); return; }
+    if (GLState_Changed(g_glState.textures[unit][slot], texture)) glBindTexture(target, texture);
+}
 
-// Mouse-look for debug camera
-static bool firstMouse = true;
-static float lastX = SCR_WIDTH * 0.5f;
-static float lastY = SCR_HEIGHT * 0.5f;
-static bool debugMouseCapture = false;
+static void GLState_SetCapability(GLenum cap, bool enabled)
+{
+    GLuint* cached = cap == GL_DEPTH_TEST ? &g_glState.depthTest : cap == GL_BLEND ? &g_glState.blend : nullptr;
+    if (cached && !GLState_Changed(*cached, enabled ? 1u : 0u)) return;
+    if (enabled) glEnable(cap);
+    else glDisable(cap);
+}
 
-// Random
-static std::mt19937 rng(std::random_device{}());
-static std::uniform_real_distribution<float> uni01(0.0f, 1.0f);
+static void GLState_Enable(GLenum cap) { GLState_SetCapability(cap, true); }
+static void GLState_Disable(GLenum cap) { GLState_SetCapability(cap, false); }
 
-// Forward declarations
-void framebuffer_size_callback(GLFWwindow*, int w, int h);
-static void processInput(GLFWwindow* window);
-static void updateDebugCameraVectors(Camera& cam);
-static void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
-static void scroll_callback(GLFWwindow* window, double xoff, double yoff);
+static void GLState_BlendFunc(GLenum src, GLenum dst)
+{
+    if (g_glState.blendSrc == src && g_glState.blendDst == dst) { ++g_frameStats.avoidedCalls; return; }
+    g_glState.blendSrc = src;
+    g_glState.blendDst = dst;
+    ++g_frameStats.stateCalls;
+    glBlendFunc(src, dst);
+}
 
-// Skybox helper
-static GLuint loadCubemap(const std::vector<std::string>& faces);
+static void GLState_DepthFunc(GLenum func)
+{
+    if (GLState_Changed(g_glState.depthFunc, func)) glDepthFunc(func);
+}
 
-// ===================== Models =====================
-// All models are loaded once and instanced in the scene.
-// Note: model_animation.h defines the class as "Model", not "Model_animation"
-static Model modelPlayer("");           // player
-static Model modelSection("");          // road section
-static Model modelWires("");            // single wires model
+// ===================== Streaming Buffers =====================
+// Per-frame dynamic data (text and UI quads, obstacle instances, indirect cull
+// records) goes through one ring buffer split into STREAM_FRAMES slots, one per
+// frame in flight, so an upload never touches memory the GPU may still read.
+// With ARB_buffer_storage the buffer is mapped once (persistent + coherent),
+// an upload is a memcpy at the slot's cursor and each slot is guarded by a
+// fence set when the frame after it starts. Without it, uploads map their range
+// unsynchronized and the buffer is orphaned whenever the ring wraps to slot 0.
+// A frame that outgrows its slot doubles the ring; the old buffer is deleted at
+// the start of the next frame, once nothing queued refers to it.
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
 
-// Multiple variant lists
-static std::vector<Model> modelCars;     // Taxi, Police, SUV, TukTuk
-static std::vector<Model> modelJumps;    // Cart, TrashBin
-static std::vector<Model> modelSlides;   // Barrier
-static std::vector<Model> modelBuildings; // Building1, Building2, Building3, Building4
+// GL 4.4 / ARB_buffer_storage entry point
+typedef void (APIENTRYP PFN_rrBufferStorage)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+static PFN_rrBufferStorage rrBufferStorage = nullptr;
 
-// ===================== Game Structures =====================
-enum class ObstacleType { None, Car, Jump, Slide, Wires };
+static const int    STREAM_FRAMES = 3;
+static const size_t STREAM_SLOT_SIZE = 1 << 20; // initial bytes per frame
 
-struct Obstacle {
-    ObstacleType type = ObstacleType::None;
-    glm::vec3    pos;    // world position
-    int          lane;   // 0..2 (index into lateral lanes along Z)
-    int          variantIndex = -1; // which model variant to render
+struct StreamRange {
+    GLuint buffer = 0;
+    size_t offset = 0;         // bytes into buffer
 };
 
-struct Section {
-    float centerX;                // center x position of the section (forward axis)
-    std::array<Obstacle, LANE_COUNT> laneObstacles; // one obstacle slot per lane
-    bool hasWires = false;
-    // building variants for this section: left front, left back, right front, right back
-    std::array<int, 4> buildingVariants;  // FIXED: Changed ) to >
+struct StreamBuffer {
+    bool   persistent = false;
+    GLuint buffer = 0;
+    unsigned char* mapped = nullptr;  // persistent mapping of the whole ring
+    size_t slotSize = 0;
+    int    slot = 0;
+    size_t cursor = 0;                // next free byte in the current slot
+    GLsync fences[STREAM_FRAMES] = {};
+    std::vector<GLuint> retired;      // outgrown buffers, deleted next frame
 };
 
-// ===================== Player =====================
-struct Player {
-    glm::vec3 pos;
-    int laneIndex = 1;
-    float laneSwitchTimer = 0.0f;
+static StreamBuffer g_stream;
 
-    // Jump / Slide state
-    bool isJumping = false;
-    float jumpTimer = 0.0f;
-    static constexpr float jumpDuration = 0.8f;
-    static constexpr float jumpHeight = 5.0f;
+static void Stream_Create(size_t slotSize)
+{
+    StreamBuffer& st = g_stream;
+    for (GLsync& f : st.fences) {
+        if (f) glDeleteSync(f);
+        f = nullptr;
+    }
+    st.slotSize = slotSize;
+    size_t total = slotSize * STREAM_FRAMES;
+    glGenBuffers(1, &st.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, st.buffer);
+    if (st.persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        rrBufferStorage(GL_COPY_WRITE_BUFFER, (GLsizeiptr)total, nullptr, flags);
+        st.mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)total, flags);
+    }
+    else {
+        glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)total, nullptr, GL_STREAM_DRAW);
+    }
+    st.cursor = st.slot * slotSize;
+}
 
-    // NEW: Track root motion offset from animation
-    glm::vec3 animationRootOffset = glm::vec3(0.0f);
-    glm::vec3 lastAnimationRootPos = glm::vec3(0.0f);
+// main thread, after GL is up
+static void Stream_Init()
+{
+    GLint major = 0, minor = 0, count = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    bool supported = major * 10 + minor >= 44;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count && !supported; ++i) {
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (ext && std::strcmp(ext, "GL_ARB_buffer_storage") == 0) supported = true;
+    }
+    if (supported) rrBufferStorage = (PFN_rrBufferStorage)glfwGetProcAddress("glBufferStorage");
+    g_stream.persistent = rrBufferStorage != nullptr;
+    Stream_Create(STREAM_SLOT_SIZE);
+    if (g_stream.persistent && !g_stream.mapped) {
+        std::cerr << "Persistent mapping failed, streaming through orphaned buffers\n";
+        GLState_DeleteBuffers(1, &g_stream.buffer);
+        g_stream.persistent = false;
+        Stream_Create(STREAM_SLOT_SIZE);
+    }
+    if (!g_stream.persistent) std::cout << "ARB_buffer_storage not supported, streaming through orphaned buffers\n";
+}
 
-    bool isSliding = false;
-    float slideTimer = 0.0f;
-    static constexpr float slideDuration = 0.6f;  // Fixed duration - slide stops automatically
+// top of every frame, before anything is uploaded: fence the frame that just
+// ended and move on to the oldest slot, waiting until the GPU is done with it
+static void Stream_BeginFrame()
+{
+    StreamBuffer& st = g_stream;
+    if (!st.buffer) return;
+    if (!st.retired.empty()) {
+        GLState_DeleteBuffers((GLsizei)st.retired.size(), st.retired.data());
+        st.retired.clear();
+    }
+    if (st.persistent) st.fences[st.slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    st.slot = (st.slot + 1) % STREAM_FRAMES;
+    st.cursor = st.slot * st.slotSize;
+
+    if (!st.persistent) {
+        if (st.slot == 0) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, st.buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)(st.slotSize * STREAM_FRAMES), nullptr, GL_STREAM_DRAW);
+        }
+        return;
+    }
+    GLsync& fence = st.fences[st.slot];
+    if (!fence) return;
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED) flags = 0;
+    glDeleteSync(fence);
+    fence = nullptr;
+}
 
-    // Lane change animation state
-    bool isSidestepping = false;
-    float sidestepTimer = 0.0f;
-    static constexpr float sidestepDuration = 0.3f;  // Duration of sidestep animation
-    int sidestepDirection = 0;  // -1 for left, +1 for right, 0 for none
-    float sidestepStartZ = 0.0f;  // Starting Z position for interpolation
-    float sidestepTargetZ = 0.0f;  // Target Z position for interpolation
+// Copy `size` bytes into this frame's slot; `alignment` need not be a power of two
+// (instance data aligns to its record size so it can be addressed by index)
+static StreamRange Stream_Upload(const void* data, size_t size, size_t alignment = 16)
+{
+    StreamBuffer& st = g_stream;
+    size_t offset = (st.cursor + alignment - 1) / alignment * alignment;
+    if (offset + size > (st.slot + 1) * st.slotSize) {
+        size_t slotSize = st.slotSize * 2;
+        while (slotSize < size + alignment) slotSize *= 2;
+        st.retired.push_back(st.buffer);
+        Stream_Create(slotSize);
+        offset = (st.cursor + alignment - 1) / alignment * alignment;
+    }
 
-    // Crouch state (held while S pressed)
-    bool isCrouching = false;
+    if (st.persistent) {
+        std::memcpy(st.mapped + offset, data, size);
+    }
+    else {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, st.buffer);
+        void* dst = glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)offset, (GLsizeiptr)size,
+                                     GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (dst) {
+            std::memcpy(dst, data, size);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        }
+    }
+    st.cursor = offset + size;
+    StreamRange range;
+    range.buffer = st.buffer;
+    range.offset = offset;
+    return range;
+}
 
-    // Score tracking
-    int score = 0;
-    float lastScoreUpdateX = 0.0f;
+// ===================== Shader Programs =====================
+// Same interface as learnopengl's Shader, plus compile-time variants (#defines
+// inserted after the #version line) and a program binary cache: linked
+// programs are saved with glGetProgramBinary under cache/shaders/, keyed by a
+// hash of the sources and the driver strings, and reloaded with glProgramBinary.
+// Any mismatch (or a binary the driver rejects) compiles from source again.
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
 
-    void startJump() {
-        if (!isJumping && !isSliding && !isSidestepping) {
-            isJumping = true;
-            jumpTimer = 0.0f;
-            animationRootOffset = glm::vec3(0.0f);
-            lastAnimationRootPos = glm::vec3(0.0f);
-        }
+// GL 4.1 / ARB_get_program_binary entry points; glad is generated for 3.3 core
+typedef void (APIENTRYP PFN_rrGetProgramBinary)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFN_rrProgramBinary)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+typedef void (APIENTRYP PFN_rrProgramParameteri)(GLuint program, GLenum pname, GLint value);
+static PFN_rrGetProgramBinary rrGetProgramBinary = nullptr;
+static PFN_rrProgramBinary rrProgramBinary = nullptr;
+static PFN_rrProgramParameteri rrProgramParameteri = nullptr;
+
+static const char SHADER_CACHE_MAGIC[4] = { 'R', 'R', 'S', 'B' };
+static const uint32_t SHADER_CACHE_VERSION = 1;
+static const char* SHADER_CACHE_DIR = "cache/shaders";
+static const char* SHADER_DIR = "src/3.model_loading/1.model_loading/";
+
+struct ShaderCacheHeader {
+    char     magic[4];
+    uint32_t version;
+    uint64_t key;             // sources + driver strings
+    uint32_t binaryFormat;
+    uint32_t binaryLength;    // bytes following the header
+};
+
+static bool g_programBinaries = false;
+static std::string g_driverString;
+
+// main thread, after GL is up
+static void ShaderCache_Init()
+{
+    auto str = [](GLenum name) { const GLubyte* s = glGetString(name); return std::string(s ? (const char*)s : ""); };
+    g_driverString = str(GL_VENDOR) + '|' + str(GL_RENDERER) + '|' + str(GL_VERSION);
+
+    rrGetProgramBinary = (PFN_rrGetProgramBinary)glfwGetProcAddress("glGetProgramBinary");
+    rrProgramBinary = (PFN_rrProgramBinary)glfwGetProcAddress("glProgramBinary");
+    rrProgramParameteri = (PFN_rrProgramParameteri)glfwGetProcAddress("glProgramParameteri");
+    GLint formats = 0;
+    if (rrGetProgramBinary && rrProgramBinary && rrProgramParameteri)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    g_programBinaries = formats > 0;
+    if (!g_programBinaries) std::cout << "Program binaries not supported, shaders compile from source\n";
+}
+
+// insert `#define NAME` lines right after the #version directive
+static std::string applyShaderDefines(const std::string& code, const std::vector<std::string>& defines)
+{
+    if (defines.empty()) return code;
+    std::string block;
+    for (const auto& d : defines) block += "#define " + d + "\n";
+    size_t insertAt = 0;
+    size_t version = code.find("#version");
+    if (version != std::string::npos) {
+        size_t eol = code.find('\n', version);
+        insertAt = eol == std::string::npos ? code.size() : eol + 1;
     }
+    std::string head = code.substr(0, insertAt);
+    if (!head.empty() && head.back() != '\n') head += '\n';
+    return head + block + code.substr(insertAt);
+}
 
-    void startSlide() {
-        if (!isSliding && !isJumping && !isSidestepping) {
-            isSliding = true;
-            slideTimer = 0.0f;
-            animationRootOffset = glm::vec3(0.0f);
-            lastAnimationRootPos = glm::vec3(0.0f);
-            std::cout << "*** SLIDE STARTED ***\n";
-        }
+static bool readTextFile(const std::string& path, std::string& out)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return false;
+    out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+class ShaderProgram {
+public:
+    GLuint ID = 0;
+
+    // file names inside SHADER_DIR, e.g. ShaderProgram("main.vs", "main.fs", { "SKINNED" })
+    ShaderProgram(const std::string& vertexFile, const std::string& fragmentFile,
+                  const std::vector<std::string>& defines = {})
+    {
+        std::string vertexCode, fragmentCode;
+        if (!readTextFile(FileSystem::getPath(SHADER_DIR + vertexFile), vertexCode) ||
+            !readTextFile(FileSystem::getPath(SHADER_DIR + fragmentFile), fragmentCode))
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << vertexFile << " / " << fragmentFile << std::endl;
+        vertexCode = applyShaderDefines(vertexCode, defines);
+        fragmentCode = applyShaderDefines(fragmentCode, defines);
+
+        // one cache file per variant, e.g. main_SKINNED.bin
+        std::string variantName = vertexFile.substr(0, vertexFile.find_last_of('.'));
+        for (const auto& d : defines) variantName += "_" + d;
+        uint64_t key = fnv1a64(vertexCode + '\0' + fragmentCode + '\0' + g_driverString);
+        std::string cachePath = FileSystem::getPath(std::string(SHADER_CACHE_DIR) + "/" + variantName + ".bin");
+        if (g_programBinaries && loadBinary(cachePath, key)) return;
+
+        GLuint vertex = compileStage(GL_VERTEX_SHADER, vertexCode, "VERTEX");
+        GLuint fragment = compileStage(GL_FRAGMENT_SHADER, fragmentCode, "FRAGMENT");
+        ID = glCreateProgram();
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, fragment);
+        if (g_programBinaries) rrProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(ID);
+        bool linked = checkLinkStatus();
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        if (linked && g_programBinaries) saveBinary(cachePath, key);
     }
 
-    void startSidestep(int direction, float currentZ, float targetZ) {
-        if (!isSidestepping && !isJumping && !isSliding) {
-            isSidestepping = true;
-            sidestepTimer = 0.0f;
-            sidestepDirection = direction;
-            sidestepStartZ = currentZ;
-            sidestepTargetZ = targetZ;
-            animationRootOffset = glm::vec3(0.0f);
-            lastAnimationRootPos = glm::vec3(0.0f);
-            std::cout << "*** SIDESTEP " << (direction < 0 ? "LEFT" : "RIGHT") << " STARTED (from " << currentZ << " to " << targetZ << ") ***\n";
+    // compute program (GL 4.3), e.g. ShaderProgram("cull.cs"); ID is 0 if it fails to build
+    explicit ShaderProgram(const std::string& computeFile)
+    {
+        std::string computeCode;
+        if (!readTextFile(FileSystem::getPath(SHADER_DIR + computeFile), computeCode)) {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << computeFile << std::endl;
+            return;
         }
+        uint64_t key = fnv1a64(computeCode + '\0' + g_driverString);
+        std::string cachePath = FileSystem::getPath(std::string(SHADER_CACHE_DIR) + "/" +
+                                                    computeFile.substr(0, computeFile.find_last_of('.')) + ".bin");
+        if (g_programBinaries && loadBinary(cachePath, key)) return;
+
+        GLuint compute = compileStage(GL_COMPUTE_SHADER, computeCode, "COMPUTE");
+        ID = glCreateProgram();
+        glAttachShader(ID, compute);
+        if (g_programBinaries) rrProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(ID);
+        bool linked = checkLinkStatus();
+        glDeleteShader(compute);
+        if (!linked) { glDeleteProgram(ID); ID = 0; return; }
+        if (g_programBinaries) saveBinary(cachePath, key);
     }
 
-    void updateScore(float dt) {
-        // Score increases based on distance traveled
-        // Every 10 units of distance = 10 points
-        float distanceTraveled = pos.x - lastScoreUpdateX;
-        if (distanceTraveled >= 10.0f) {
-            score += 10;
-            lastScoreUpdateX = pos.x;
-        }
+    void use() const { GLState_UseProgram(ID); }
+    void setBool(const std::string& name, bool value) const { glUniform1i(location(name), (int)value); }
+    void setInt(const std::string& name, int value) const { glUniform1i(location(name), value); }
+    void setFloat(const std::string& name, float value) const { glUniform1f(location(name), value); }
+    void setVec3(const std::string& name, const glm::vec3& value) const { glUniform3fv(location(name), 1, glm::value_ptr(value)); }
+    void setVec3(const std::string& name, float x, float y, float z) const { glUniform3f(location(name), x, y, z); }
+    void setMat3(const std::string& name, const glm::mat3& mat) const { glUniformMatrix3fv(location(name), 1, GL_FALSE, glm::value_ptr(mat)); }
+    void setMat4(const std::string& name, const glm::mat4& mat) const { glUniformMatrix4fv(location(name), 1, GL_FALSE, glm::value_ptr(mat)); }
+
+    // looked up once per name (-1 is cached too, so missing uniforms stay cheap)
+    GLint location(const std::string& name) const
+    {
+        auto it = uniformLocations.find(name);
+        if (it != uniformLocations.end()) return it->second;
+        GLint loc = glGetUniformLocation(ID, name.c_str());
+        uniformLocations.emplace(name, loc);
+        return loc;
     }
 
-    void updateTimers(float dt) {
-        if (isJumping) {
-            jumpTimer += dt;
-            if (jumpTimer >= jumpDuration) {
-                isJumping = false;
-                jumpTimer = 0.0f;
-                animationRootOffset = glm::vec3(0.0f);
-            }
+private:
+    mutable std::unordered_map<std::string, GLint> uniformLocations;
+
+    static GLuint compileStage(GLenum type, const std::string& code, const char* typeName)
+    {
+        GLuint stage = glCreateShader(type);
+        const char* src = code.c_str();
+        glShaderSource(stage, 1, &src, NULL);
+        glCompileShader(stage);
+        GLint success;
+        glGetShaderiv(stage, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            GLchar infoLog[1024];
+            glGetShaderInfoLog(stage, 1024, NULL, infoLog);
+            std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << typeName << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
         }
-        if (isSliding) {
-            slideTimer += dt;
-            if (slideTimer >= slideDuration) {
-                isSliding = false;
-                slideTimer = 0.0f;
-                animationRootOffset = glm::vec3(0.0f);
-                std::cout << "*** SLIDE ENDED ***\n";
-                Audio_StopSlide();
-                Audio_PlayRunningLoop();
-            }
+        return stage;
+    }
+
+    bool checkLinkStatus() const
+    {
+        GLint success;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!success) {
+            GLchar infoLog[1024];
+            glGetProgramInfoLog(ID, 1024, NULL, infoLog);
+            std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: PROGRAM\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
         }
-        if (isSidestepping) {
-            sidestepTimer += dt;
-            if (sidestepTimer >= sidestepDuration) {
-                isSidestepping = false;
-                sidestepTimer = 0.0f;
-                sidestepDirection = 0;
-                animationRootOffset = glm::vec3(0.0f);
-                // Snap to final target position when animation ends
-                pos.z = sidestepTargetZ;
-                std::cout << "*** SIDESTEP ENDED (final Z: " << pos.z << ") ***\n";
-            }
+        return success != 0;
+    }
+
+    bool loadBinary(const std::string& path, uint64_t key)
+    {
+        MappedFile file;
+        if (!mapFile(path, file)) return false;
+        const ShaderCacheHeader* h = (const ShaderCacheHeader*)file.data;
+        bool valid = file.size >= sizeof(ShaderCacheHeader) &&
+            std::memcmp(h->magic, SHADER_CACHE_MAGIC, sizeof(SHADER_CACHE_MAGIC)) == 0 &&
+            h->version == SHADER_CACHE_VERSION && h->key == key &&
+            h->binaryLength <= file.size - sizeof(ShaderCacheHeader);
+        GLint linked = 0;
+        if (valid) {
+            ID = glCreateProgram();
+            rrProgramBinary(ID, h->binaryFormat, file.data + sizeof(ShaderCacheHeader), (GLsizei)h->binaryLength);
+            glGetProgramiv(ID, GL_LINK_STATUS, &linked);
+            if (!linked) { glDeleteProgram(ID); ID = 0; } // driver rejected it (e.g. after an update)
         }
-        if (laneSwitchTimer > 0.0f) laneSwitchTimer = std::max(0.0f, laneSwitchTimer - dt);
+        unmapFile(file);
+        return linked != 0;
+    }
+
+    void saveBinary(const std::string& path, uint64_t key) const
+    {
+        GLint length = 0;
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+        std::vector<unsigned char> blob(sizeof(ShaderCacheHeader) + (size_t)length);
+        ShaderCacheHeader header = {};
+        std::memcpy(header.magic, SHADER_CACHE_MAGIC, sizeof(SHADER_CACHE_MAGIC));
+        header.version = SHADER_CACHE_VERSION;
+        header.key = key;
+        GLenum format = 0;
+        GLsizei written = 0;
+        rrGetProgramBinary(ID, length, &written, &format, blob.data() + sizeof(ShaderCacheHeader));
+        if (written <= 0) return;
+        header.binaryFormat = format;
+        header.binaryLength = (uint32_t)written;
+        std::memcpy(blob.data(), &header, sizeof(header));
+
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+        // a crash mid-write must not leave a truncated binary behind for the next launch
+        writeFileReplacing(path, blob.data(), sizeof(ShaderCacheHeader) + (size_t)written);
     }
 };
 
-// ===================== World =====================
-static std::vector<Section> sections;
-static Player player;
+// ===================== Text Rendering =====================
+struct Character {
+    unsigned int TextureID; // ID handle of the glyph texture
+    glm::ivec2   Size;      // Size of glyph
+    glm::ivec2   Bearing;   // Offset from baseline to left/top of glyph
+    unsigned int Advance;   // Horizontal offset to advance to next glyph
+};
 
-// Keep track of which section index the player is currently in (sections are laid out increasing in X)
-static int currentSectionIndex = 0;
-static const int SECTIONS_AHEAD = 10;
+static std::map<GLchar, Character> Characters;
+static GLuint textVAO;
+static ShaderProgram* textShader = nullptr;
 
-// Game spawn/reset positions
-static glm::vec3 worldStartCenter(0.0f, 0.0f, 0.0f);
-static glm::vec3 playerSpawnPos;
+// Player Config
 
-// Utility: lane Z coordinate (lateral)
-static float laneZ(int idx) {
-    return (idx - 1) * LANE_Z_SPACING; // idx 0 -> -spacing, 1->0, 2->+spacing
-}
+// Player Config
+static const float PLAYER_SCALE = 3.75f;
+static const float PLAYER_RADIUS = 1.0f * PLAYER_SCALE;
+static const float PLAYER_SPAWN_HEIGHT = 1.0f;
 
-// Helper to pick a variant index safely
-static int pickVariantIndex(size_t count) {
-    if (count == 0) return -1;
-    int idx = static_cast<int>(std::floor(uni01(rng) * float(count)));
-    if (idx < 0) idx = 0;
-    if (idx >= (int)count) idx = (int)count - 1;
-    return idx;
-}
+// Camera Config
+static const float CAM_DISTANCE = 25.0f;
+static const float CAM_HEIGHT = 10.0f;
+static const float CAM_SMOOTHING = 5.0f;  // Camera smoothing factor (higher = faster follow)
+static const float CAM_NEAR_PLANE = 0.1f;
+static float g_farPlane = 500.0f;  // view distance (Settings)
 
-// Helper to stringify obstacle type
-static const char* obstacleTypeName(ObstacleType t) {
-    switch (t) {
-    case ObstacleType::None: return "None";
-    case ObstacleType::Car:  return "Car";
-    case ObstacleType::Jump: return "Jump";
-    case ObstacleType::Slide: return "Slide";
-    case ObstacleType::Wires: return "Wires";
-    default: return "Unknown";
-    }
-}
+// Scene Config
+static const float LANE_Z_SPACING = 15.0f;   // z offset between lanes
+static const float SIDEWALK_WIDTH = 12.0f;   // extra width on each side of the road for buildings
+static const int   LANE_COUNT = 3;
+static const float SECTION_LENGTH = 64.0f;  // length of a road section (equal to 2 buildings)
+static const float BUILDING_LENGTH = SECTION_LENGTH / 2.0f;
+
+static const float PLAYER_FORWARD_SPEED = 30.0f; // automatic forward speed (units/sec) along +X
+static const float LANE_SWITCH_COOLDOWN = 0.18f; // seconds between lane changes
+
+// Obstacle spawn chances (per lane per section)
+static float PROB_CAR = 0.25f;
+static float PROB_JUMP = 0.20f;
+static float PROB_SLIDE = 0.20f;
+static float PROB_WIRES = 0.08f; // special case; if wires spawn, only middle lane spawns them (they cross all lanes)
+
+// Collision threshold along forward axis (X)
+static const float OBSTACLE_HIT_AXIS_RADIUS = 1.2f; // distance along X to consider collision
+static const float OBSTACLE_RENDER_HEIGHT = 0.0f;
+
+// Crouch render height (when holding S)
+static const float PLAYER_CROUCH_HEIGHT = 0.0f;
+
+// Animation states
+enum AnimState {
+    RUNNING,
+    RUNNING_JUMP,
+    JUMP,
+    JUMP_RUNNING,
+    RUNNING_SLIDE,
+    SLIDE,
+    SLIDE_RUNNING,
+    RUNNING_SIDESTEP_LEFT,
+    SIDESTEP_LEFT,
+    SIDESTEP_LEFT_RUNNING,
+    RUNNING_SIDESTEP_RIGHT,
+    SIDESTEP_RIGHT,
+    SIDESTEP_RIGHT_RUNNING
+};
+
+// ===================== State & Helpers =====================
+Camera camera(glm::vec3(0.0f, 2.0f, 8.0f));
+float deltaTime = 0.f, lastFrame = 0.f;
+
+// Camera smoothing
+static glm::vec3 cameraTargetPos = glm::vec3(0.0f, CAM_HEIGHT, -CAM_DISTANCE);
+
+static bool debugCameraEnabled = false;
+static float debugYaw = -90.0f;
+static float debugPitch = 0.0f;
+static const float DEBUG_CAM_SPEED = 40.0f;      // units / second
+static const float DEBUG_CAM_TURN_SPEED = 90.0f; // degrees / second
+
+// Mouse-look for debug camera
+static bool firstMouse = true;
+static float lastX = SCR_WIDTH * 0.5f;
+static float lastY = SCR_HEIGHT * 0.5f;
+static bool debugMouseCapture = false;
+
+// Random
+static std::mt19937 rng(std::random_device{}());
+static std::uniform_real_distribution<float> uni01(0.0f, 1.0f);
+
+// Forward declarations
+void framebuffer_size_callback(GLFWwindow*, int w, int h);
+static void processInput(GLFWwindow* window);
+static void updateDebugCameraVectors(Camera& cam);
+static void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+static void scroll_callback(GLFWwindow* window, double xoff, double yoff);
+
+// ===================== Models =====================
+// All models are loaded once and instanced in the scene.
+// Geometry and textures live in renderer-owned GL objects (see Asset Loading);
+// model_animation.h's Model is only kept as the player's skeleton for Animation.
+struct RenderMesh {
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLsizei indexCount = 0;
+    GLuint diffuseTexture = 0;  // 0 = leave whatever is bound (matches Mesh::Draw)
+};
+
+struct MeshData;
+
+struct RenderModel {
+    std::vector<RenderMesh> meshes;
+    std::vector<GLuint> textures; // owned textures, shared between meshes
+    std::vector<uint32_t> materials; // per texture once moved into texture arrays (see Texture Arrays)
+    bool keepGeometry = false;     // keep a CPU copy of the meshes (static batching)
+    std::vector<MeshData> geometry;
+    std::vector<std::vector<MeshData>> lods; // simplified geometry for LOD 1.. (see Level of Detail)
+};
+
+static RenderModel modelPlayer;         // player
+static Model playerSkeleton("");        // player bone map, used by the animation clips
+static RenderModel modelSection;        // road section
+static RenderModel modelWires;          // single wires model
+
+// Multiple variant lists
+static std::vector<RenderModel> modelCars;     // Taxi, Police, SUV, TukTuk
+static std::vector<RenderModel> modelJumps;    // Cart, TrashBin
+static std::vector<RenderModel> modelSlides;   // Barrier
+static std::vector<RenderModel> modelBuildings; // Building1, Building2, Building3, Building4
+
+// Every model file the game loads, relative to resources/objects/RoadRunner.
+// Shared by the loader and the --bake step.
+static const char* PLAYER_MODEL_FILE = "player.dae";
+static const char* PLAYER_FALLBACK_MODEL_FILE = "Treadmill Running.dae";
+static const std::vector<std::string> PLAYER_ANIMATION_FILES = {
+    "Treadmill Running.dae", "Jump.dae", "Running Slide.dae", "Side Step Left.dae", "Side Step Right.dae"
+};
+static const char* SECTION_MODEL_FILE = "Section.obj";
+static const char* WIRES_MODEL_FILE = "Wires.obj";
+static const std::vector<std::string> BUILDING_MODEL_FILES = { "Building1.obj", "Building2.obj", "Building3.obj", "Building4.obj" };
+static const std::vector<std::string> CAR_MODEL_FILES = { "Taxi.obj", "Police.obj", "SUV.obj", "TukTuk.obj" };
+static const std::vector<std::string> JUMP_MODEL_FILES = { "Cart.obj", "TrashBin.obj" };
+static const std::vector<std::string> SLIDE_MODEL_FILES = { "Barrier.obj" };
+// cubemap faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+static const std::vector<std::string> SKYBOX_FACE_FILES = {
+    "resources/textures/skybox/right.jpg", "resources/textures/skybox/left.jpg",
+    "resources/textures/skybox/top.jpg", "resources/textures/skybox/bottom.jpg",
+    "resources/textures/skybox/front.jpg", "resources/textures/skybox/back.jpg"
+};
+
+// ===================== Asset Loading =====================
+// File reading, Assimp parsing and image decoding run on a small worker pool.
+// Anything that touches GL is queued back to the main thread and drained under
+// a per-frame time budget, so the start screen shows up before the assets do.
+// The pool and queue stay up in game for section streaming (see Generation).
+static const double UPLOAD_BUDGET_SECONDS = 0.004; // GL upload time allowed per frame while loading
+
+static std::vector<std::thread> g_jobWorkers;
+static std::deque<std::function<void()>> g_jobQueue;
+static std::mutex g_jobMutex;
+static std::condition_variable g_jobCv;
+static bool g_jobsStopping = false;
+
+static std::deque<std::function<void()>> g_uploadQueue;
+static std::mutex g_uploadMutex;
+
+// progress is counted per asset (a model, the animation set, the skybox)
+static std::atomic<int> g_assetsTotal{0};
+static std::atomic<int> g_assetsDone{0};
+
+static void Jobs_WorkerLoop()
+{
+    for (;;) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(g_jobMutex);
+            g_jobCv.wait(lock, [] { return g_jobsStopping || !g_jobQueue.empty(); });
+            if (g_jobsStopping) return;
+            job = std::move(g_jobQueue.front());
+            g_jobQueue.pop_front();
+        }
+        job();
+    }
+}
+
+static void Jobs_Init()
+{
+    if (!g_jobWorkers.empty()) return;
+    // leave one core for the main (GL) thread
+    unsigned hw = std::thread::hardware_concurrency();
+    unsigned count = hw > 1 ? hw - 1 : 1;
+    g_jobsStopping = false;
+    for (unsigned i = 0; i < count; ++i) g_jobWorkers.emplace_back(Jobs_WorkerLoop);
+}
+
+static void Jobs_Submit(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(g_jobMutex);
+        g_jobQueue.push_back(std::move(job));
+    }
+    g_jobCv.notify_one();
+}
+
+static void Jobs_Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_jobMutex);
+        g_jobsStopping = true;
+        g_jobQueue.clear(); // drop work that hasn't started; running jobs finish normally
+    }
+    g_jobCv.notify_all();
+    for (std::thread& t : g_jobWorkers) t.join();
+    g_jobWorkers.clear();
+}
+
+// queue a batch of GL steps for the main thread; the batch stays contiguous so
+// one asset's steps are never interleaved with another's
+static void Loader_QueueUploads(std::vector<std::function<void()>> steps)
+{
+    std::lock_guard<std::mutex> lock(g_uploadMutex);
+    for (auto& step : steps) g_uploadQueue.push_back(std::move(step));
+}
+
+// main thread: run queued GL steps until the time budget or `maxSteps` is used
+// up (always at least one)
+static void Loader_DrainUploads(double budgetSeconds, int maxSteps = INT_MAX)
+{
+    double start = glfwGetTime();
+    for (int done = 1;; ++done) {
+        std::function<void()> step;
+        {
+            std::lock_guard<std::mutex> lock(g_uploadMutex);
+            if (g_uploadQueue.empty()) return;
+            step = std::move(g_uploadQueue.front());
+            g_uploadQueue.pop_front();
+        }
+        step();
+        if (done >= maxSteps || glfwGetTime() - start >= budgetSeconds) return;
+    }
+}
+
+static bool Loader_IsDone()
+{
+    return g_assetsDone.load() >= g_assetsTotal.load();
+}
+
+static float Loader_Progress()
+{
+    int total = g_assetsTotal.load();
+    if (total <= 0) return 1.0f;
+    return std::min(1.0f, (float)g_assetsDone.load() / (float)total);
+}
+
+// CPU-side results of a worker job, handed to the main thread for upload
+struct DecodedImage {
+    std::string path;
+    int width = 0, height = 0, channels = 0;
+    unsigned char* pixels = nullptr; // owned by stb_image until uploaded
+    AssetBlob compressed;            // .rrtex contents instead of pixels (see Texture Cache)
+
+    bool loaded() const { return pixels || compressed.data; }
+};
+
+// Compact GPU vertex formats (attribute setup in uploadRenderMesh). Normals are
+// packed 10:10:10:2, UVs are half floats and there are no tangents, since
+// nothing is normal mapped. Only meshes with bones get the skinning attributes,
+// with 8-bit bone ids (MAX_BONES in main.vs is 100) and weights.
+struct StaticVertex {
+    float    position[3];
+    uint32_t normal;         // GL_INT_2_10_10_10_REV
+    uint16_t texCoords[2];   // GL_HALF_FLOAT
+};
+
+struct SkinnedVertex {
+    StaticVertex base;
+    uint8_t      boneIds[MAX_BONE_INFLUENCE];
+    uint8_t      weights[MAX_BONE_INFLUENCE]; // normalized, sum to 255
+};
+
+struct MeshData {
+    std::vector<unsigned char> vertices; // StaticVertex or SkinnedVertex array
+    uint32_t vertexCount = 0;
+    bool skinned = false;
+    std::vector<unsigned int> indices;
+    int diffuseTexture = -1; // index into ModelData::textureFiles
+};
+
+struct ModelData {
+    std::string path;
+    std::string directory;
+    std::vector<MeshData> meshes;
+    std::vector<std::string> textureFiles;  // relative to directory
+    std::vector<DecodedImage> images;       // decoded textureFiles (same order)
+    std::map<std::string, BoneInfo> boneInfoMap;
+    int boneCount = 0;
+    std::vector<std::vector<MeshData>> lods; // built by the load job for keepGeometry models
+};
+
+// stb_image's flip flag is global and not thread-safe, so workers always decode
+// top-down and flip model textures themselves
+static void flipImageRows(unsigned char* pixels, int width, int height, int channels)
+{
+    size_t stride = (size_t)width * channels;
+    std::vector<unsigned char> row(stride);
+    for (int y = 0; y < height / 2; ++y) {
+        unsigned char* a = pixels + stride * y;
+        unsigned char* b = pixels + stride * (height - 1 - y);
+        std::copy(a, a + stride, row.begin());
+        std::copy(b, b + stride, a);
+        std::copy(row.begin(), row.end(), b);
+    }
+}
+
+// ===================== Texture Cache =====================
+// Textures are kept on disk pre-mipmapped and block-compressed (BC1 for RGB/grey,
+// BC3 when there is alpha, including grey+alpha) in a small KTX-like container, `<image>.rrtex`. The
+// cache is written the first time an image is decoded (or by --bake) and
+// uploaded with glCompressedTexImage2D afterwards, skipping JPEG/PNG decoding.
+// Needs EXT_texture_compression_s3tc; without it textures load as before.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+static const char TEXCACHE_MAGIC[4] = { 'R', 'R', 'T', 'X' };
+static const uint32_t TEXCACHE_VERSION = 2;
+static const uint32_t TEXCACHE_FLIPPED = 1;   // rows flipped like model textures
+
+struct TexCacheHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t glFormat;        // GL_COMPRESSED_*_S3TC_*
+    uint32_t width, height;
+    uint32_t channels;        // of the source image
+    uint32_t levelCount;      // full mip chain down to 1x1
+    uint32_t flags;
+    uint64_t sourceSize;      // stamp of the source image, same as BakedHeader
+    int64_t  sourceTime;
+};
+
+struct TexCacheLevel {        // levelCount of these follow the header
+    uint32_t width, height;
+    uint64_t offset, size;
+};
+
+static bool g_textureCompression = false; // set once S3TC support is known, before any loading
+
+static std::string texCachePathFor(const std::string& sourcePath) { return sourcePath + ".rrtex"; }
+
+static uint16_t packRgb565(int r, int g, int b)
+{
+    return (uint16_t)((((r * 31 + 127) / 255) << 11) | (((g * 63 + 127) / 255) << 5) | ((b * 31 + 127) / 255));
+}
+
+static void unpackRgb565(uint16_t c, int rgb[3])
+{
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// 4x4 RGBA block -> 8-byte BC1 colour block. Endpoints are the inset bounding box
+// of the block, with each channel's diagonal direction taken from its
+// covariance with the widest channel.
+static void encodeColorBlock(const unsigned char px[64], unsigned char out[8])
+{
+    int mn[3] = { 255, 255, 255 }, mx[3] = { 0, 0, 0 }, sum[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < 3; ++c) {
+            mn[c] = std::min(mn[c], (int)px[i * 4 + c]);
+            mx[c] = std::max(mx[c], (int)px[i * 4 + c]);
+            sum[c] += px[i * 4 + c];
+        }
+    int axis = 0;
+    for (int c = 1; c < 3; ++c) if (mx[c] - mn[c] > mx[axis] - mn[axis]) axis = c;
+    int hi[3], lo[3];
+    for (int c = 0; c < 3; ++c) {
+        int cov = 0;
+        for (int i = 0; i < 16; ++i) cov += (px[i * 4 + c] * 16 - sum[c]) * (px[i * 4 + axis] * 16 - sum[axis]) / 256;
+        int inset = (mx[c] - mn[c]) >> 4;
+        hi[c] = cov >= 0 ? mx[c] - inset : mn[c] + inset;
+        lo[c] = cov >= 0 ? mn[c] + inset : mx[c] - inset;
+    }
+
+    uint16_t c0 = packRgb565(hi[0], hi[1], hi[2]), c1 = packRgb565(lo[0], lo[1], lo[2]);
+    if (c0 < c1) std::swap(c0, c1); // c0 > c1 selects the four-colour mode
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int pal[4][3];
+        unpackRgb565(c0, pal[0]);
+        unpackRgb565(c1, pal[1]);
+        for (int c = 0; c < 3; ++c) {
+            pal[2][c] = (2 * pal[0][c] + pal[1][c]) / 3;
+            pal[3][c] = (pal[0][c] + 2 * pal[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestDist = INT_MAX;
+            for (int p = 0; p < 4; ++p) {
+                int dr = px[i * 4] - pal[p][0], dg = px[i * 4 + 1] - pal[p][1], db = px[i * 4 + 2] - pal[p][2];
+                int dist = dr * dr + dg * dg + db * db;
+                if (dist < bestDist) { bestDist = dist; best = p; }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+    out[0] = (unsigned char)(c0 & 0xFF); out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xFF); out[3] = (unsigned char)(c1 >> 8);
+    for (int b = 0; b < 4; ++b) out[4 + b] = (unsigned char)(indices >> (8 * b));
+}
+
+// 4x4 RGBA block -> 8-byte BC3 alpha block (eight-value mode, min/max endpoints)
+static void encodeAlphaBlock(const unsigned char px[64], unsigned char out[8])
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; ++i) { a0 = std::max(a0, (int)px[i * 4 + 3]); a1 = std::min(a1, (int)px[i * 4 + 3]); }
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        int pal[8] = { a0, a1 };
+        for (int p = 1; p < 7; ++p) pal[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+        for (int i = 0; i < 16; ++i) {
+            int best = 0, bestDist = INT_MAX;
+            for (int p = 0; p < 8; ++p) {
+                int dist = std::abs(px[i * 4 + 3] - pal[p]);
+                if (dist < bestDist) { bestDist = dist; best = p; }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    out[0] = (unsigned char)a0;
+    out[1] = (unsigned char)a1;
+    for (int b = 0; b < 6; ++b) out[2 + b] = (unsigned char)(indices >> (8 * b));
+}
+
+// worker thread: mip chain + BC1/BC3 encode of a decoded image, as a .rrtex file image
+static std::vector<unsigned char> encodeTextureCache(const DecodedImage& img, uint32_t flags, uint64_t sourceSize, int64_t sourceTime)
+{
+    bool alpha = img.channels == 2 || img.channels == 4;
+    size_t blockBytes = alpha ? 16 : 8;
+
+    // expand to RGBA; grey sources are replicated so they sample the same as GL_RED's .r,
+    // and grey+alpha keeps its alpha in .a
+    std::vector<unsigned char> level((size_t)img.width * img.height * 4);
+    for (size_t i = 0; i < (size_t)img.width * img.height; ++i) {
+        const unsigned char* s = img.pixels + i * img.channels;
+        unsigned char* d = &level[i * 4];
+        d[0] = s[0];
+        d[1] = img.channels >= 3 ? s[1] : s[0];
+        d[2] = img.channels >= 3 ? s[2] : s[0];
+        d[3] = alpha ? s[img.channels - 1] : 255;
+    }
+
+    TexCacheHeader header = {};
+    std::memcpy(header.magic, TEXCACHE_MAGIC, sizeof(TEXCACHE_MAGIC));
+    header.version = TEXCACHE_VERSION;
+    header.glFormat = alpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    header.width = (uint32_t)img.width;
+    header.height = (uint32_t)img.height;
+    header.channels = (uint32_t)img.channels;
+    header.flags = flags;
+    header.sourceSize = sourceSize;
+    header.sourceTime = sourceTime;
+    header.levelCount = 1;
+    for (int s = std::max(img.width, img.height); s > 1; s >>= 1) ++header.levelCount;
+
+    std::vector<unsigned char> blob(sizeof(TexCacheHeader) + sizeof(TexCacheLevel) * header.levelCount);
+    int w = img.width, h = img.height;
+    for (uint32_t l = 0; l < header.levelCount; ++l) {
+        int bx = (w + 3) / 4, by = (h + 3) / 4;
+        TexCacheLevel info = { (uint32_t)w, (uint32_t)h, (blob.size() + 15) & ~uint64_t(15), blockBytes * bx * by };
+        blob.resize(info.offset + info.size);
+        unsigned char* dst = &blob[info.offset];
+        unsigned char block[64];
+        for (int y = 0; y < by; ++y)
+            for (int x = 0; x < bx; ++x, dst += blockBytes) {
+                for (int i = 0; i < 16; ++i) { // clamp partial edge blocks
+                    int sx = std::min(x * 4 + (i & 3), w - 1), sy = std::min(y * 4 + (i >> 2), h - 1);
+                    std::memcpy(block + i * 4, &level[((size_t)sy * w + sx) * 4], 4);
+                }
+                if (alpha) { encodeAlphaBlock(block, dst); encodeColorBlock(block, dst + 8); }
+                else encodeColorBlock(block, dst);
+            }
+        std::memcpy(&blob[sizeof(TexCacheHeader) + l * sizeof(TexCacheLevel)], &info, sizeof(info));
+
+        // 2x2 box filter down to the next level
+        int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+        std::vector<unsigned char> next((size_t)nw * nh * 4);
+        for (int y = 0; y < nh; ++y)
+            for (int x = 0; x < nw; ++x)
+                for (int c = 0; c < 4; ++c) {
+                    int x0 = std::min(x * 2, w - 1), x1 = std::min(x * 2 + 1, w - 1);
+                    int y0 = std::min(y * 2, h - 1), y1 = std::min(y * 2 + 1, h - 1);
+                    int total = level[((size_t)y0 * w + x0) * 4 + c] + level[((size_t)y0 * w + x1) * 4 + c] +
+                                level[((size_t)y1 * w + x0) * 4 + c] + level[((size_t)y1 * w + x1) * 4 + c];
+                    next[((size_t)y * nw + x) * 4 + c] = (unsigned char)((total + 2) / 4);
+                }
+        level.swap(next);
+        w = nw; h = nh;
+    }
+    std::memcpy(&blob[0], &header, sizeof(header));
+    return blob;
+}
+
+// Check a .rrtex against its format and, for loose files, its source's size/mtime.
+// Every level must be in range and exactly the size of its block grid.
+static const TexCacheHeader* validateTextureCache(const AssetBlob& f, const std::string& sourcePath, bool checkSource)
+{
+    if (f.size < sizeof(TexCacheHeader)) return nullptr;
+    const TexCacheHeader* h = (const TexCacheHeader*)f.data;
+    if (std::memcmp(h->magic, TEXCACHE_MAGIC, sizeof(TEXCACHE_MAGIC)) != 0 || h->version != TEXCACHE_VERSION) return nullptr;
+    uint64_t blockBytes = h->glFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 16 : h->glFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT ? 8 : 0;
+    if (blockBytes == 0) return nullptr;
+    if (h->levelCount == 0 || h->levelCount > 32 || sizeof(TexCacheLevel) * (uint64_t)h->levelCount > f.size - sizeof(TexCacheHeader)) return nullptr;
+
+    if (checkSource) {
+        uint64_t size = 0; int64_t time = 0;
+        if (!sourceStamp(FileSystem::getPath(sourcePath), size, time) || size != h->sourceSize || time != h->sourceTime) return nullptr;
+    }
+
+    const TexCacheLevel* levels = (const TexCacheLevel*)(h + 1);
+    for (uint32_t l = 0; l < h->levelCount; ++l) {
+        const TexCacheLevel& level = levels[l];
+        uint64_t blocks = (uint64_t)std::max(1u, (level.width + 3) / 4) * std::max(1u, (level.height + 3) / 4);
+        if (level.size != blocks * blockBytes) return nullptr;
+        if (level.offset > f.size || level.size > f.size - level.offset) return nullptr;
+    }
+    return h;
+}
+
+// worker thread: load one image for upload, from its .rrtex when there is a
+// current one, otherwise by decoding the source (and writing the cache for
+// next time). `flip` flips rows like the model loader expects.
+static bool loadTextureImage(const std::string& relPath, bool flip, DecodedImage& img)
+{
+    img.path = relPath;
+    uint32_t flags = flip ? TEXCACHE_FLIPPED : 0;
+    if (g_textureCompression) {
+        AssetBlob cached;
+        if (Assets_Open(texCachePathFor(relPath), cached)) {
+            const TexCacheHeader* h = validateTextureCache(cached, relPath, cached.owner != nullptr);
+            if (h && h->flags == flags) {
+                img.width = (int)h->width;
+                img.height = (int)h->height;
+                img.channels = (int)h->channels;
+                img.compressed = cached;
+                return true;
+            }
+        }
+    }
+
+    AssetBlob source;
+    if (Assets_Open(relPath, source))
+        img.pixels = stbi_load_from_memory(source.data, (int)source.size, &img.width, &img.height, &img.channels, 0);
+    if (!img.pixels) return false;
+    if (flip) flipImageRows(img.pixels, img.width, img.height, img.channels);
+    if (!g_textureCompression) return true;
+
+    // only loose sources get a cache file; packed ones are cached by --bake/--pack
+    bool loose = source.owner != nullptr;
+    uint64_t size = 0; int64_t time = 0;
+    if (loose) sourceStamp(FileSystem::getPath(relPath), size, time);
+    auto bytes = std::make_shared<std::vector<unsigned char>>(encodeTextureCache(img, flags, size, time));
+    if (loose) {
+        // another worker may have the current cache file mapped (shared texture)
+        writeFileReplacing(FileSystem::getPath(texCachePathFor(relPath)), bytes->data(), bytes->size());
+    }
+    stbi_image_free(img.pixels);
+    img.pixels = nullptr;
+    img.compressed.data = bytes->data();
+    img.compressed.size = bytes->size();
+    img.compressed.owner = bytes;
+    return true;
+}
+
+// main thread: upload a cached image's levels to `target` (a 2D target or cube
+// face); returns the number of levels
+static int uploadCompressedLevels(GLenum target, const DecodedImage& img)
+{
+    const TexCacheHeader* h = (const TexCacheHeader*)img.compressed.data;
+    const TexCacheLevel* levels = (const TexCacheLevel*)(h + 1);
+    for (uint32_t l = 0; l < h->levelCount; ++l)
+        glCompressedTexImage2D(target, (GLint)l, h->glFormat, (GLsizei)levels[l].width, (GLsizei)levels[l].height, 0,
+                               (GLsizei)levels[l].size, img.compressed.data + levels[l].offset);
+    return (int)h->levelCount;
+}
+
+// main thread, after GL is up: S3TC is an extension in core 3.3
+static void detectTextureCompression()
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; ++i) {
+        const char* ext = (const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+        if (ext && std::strcmp(ext, "GL_EXT_texture_compression_s3tc") == 0) g_textureCompression = true;
+    }
+    if (!g_textureCompression) std::cout << "S3TC not supported, textures load uncompressed\n";
+}
+
+static void decodeModelTextures(ModelData& data)
+{
+    data.images.resize(data.textureFiles.size());
+    for (size_t i = 0; i < data.textureFiles.size(); ++i) {
+        DecodedImage& img = data.images[i];
+        if (!loadTextureImage(data.directory + '/' + data.textureFiles[i], true, img))
+            std::cerr << "Texture failed to load at path: " << img.path << std::endl;
+    }
+}
+
+static int registerTextureFile(ModelData& data, const std::string& relPath)
+{
+    for (size_t i = 0; i < data.textureFiles.size(); ++i)
+        if (data.textureFiles[i] == relPath) return (int)i;
+    data.textureFiles.push_back(relPath);
+    return (int)data.textureFiles.size() - 1;
+}
+
+// same vertex/bone processing as model_animation.h, minus the GL calls
+static void extractBoneWeights(ModelData& data, std::vector<Vertex>& vertices, const aiMesh* mesh)
+{
+    for (unsigned int b = 0; b < mesh->mNumBones; ++b) {
+        std::string boneName = mesh->mBones[b]->mName.C_Str();
+        int boneID;
+        auto it = data.boneInfoMap.find(boneName);
+        if (it == data.boneInfoMap.end()) {
+            BoneInfo info;
+            info.id = data.boneCount;
+            info.offset = AssimpGLMHelpers::ConvertMatrixToGLMFormat(mesh->mBones[b]->mOffsetMatrix);
+            data.boneInfoMap[boneName] = info;
+            boneID = data.boneCount++;
+        }
+        else {
+            boneID = it->second.id;
+        }
+
+        const aiVertexWeight* weights = mesh->mBones[b]->mWeights;
+        for (unsigned int w = 0; w < mesh->mBones[b]->mNumWeights; ++w) {
+            unsigned int vertexId = weights[w].mVertexId;
+            if (vertexId >= vertices.size()) continue;
+            Vertex& v = vertices[vertexId];
+            for (int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
+                if (v.m_BoneIDs[i] < 0) {
+                    v.m_BoneIDs[i] = boneID;
+                    v.m_Weights[i] = weights[w].mWeight;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static StaticVertex packStaticVertex(const Vertex& v)
+{
+    StaticVertex out;
+    out.position[0] = v.Position.x;
+    out.position[1] = v.Position.y;
+    out.position[2] = v.Position.z;
+    out.normal = glm::packSnorm3x10_1x2(glm::vec4(v.Normal.x, v.Normal.y, v.Normal.z, 0.0f));
+    out.texCoords[0] = glm::packHalf1x16(v.TexCoords.x);
+    out.texCoords[1] = glm::packHalf1x16(v.TexCoords.y);
+    return out;
+}
+
+// weights are quantized to bytes; the rounding error goes to the largest one
+// so they still sum to 1
+static SkinnedVertex packSkinnedVertex(const Vertex& v)
+{
+    SkinnedVertex out;
+    out.base = packStaticVertex(v);
+    float total = 0.0f;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; ++i)
+        if (v.m_BoneIDs[i] >= 0) total += v.m_Weights[i];
+    int sum = 0, largest = 0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; ++i) {
+        bool used = v.m_BoneIDs[i] >= 0 && v.m_BoneIDs[i] <= 255 && total > 0.0f;
+        out.boneIds[i] = used ? (uint8_t)v.m_BoneIDs[i] : 0;
+        out.weights[i] = used ? (uint8_t)std::lround(v.m_Weights[i] / total * 255.0f) : 0;
+        sum += out.weights[i];
+        if (out.weights[i] > out.weights[largest]) largest = i;
+    }
+    if (sum > 0) out.weights[largest] = (uint8_t)(out.weights[largest] + 255 - sum);
+    return out;
+}
+
+static void processMeshData(ModelData& data, const aiMesh* mesh, const aiScene* scene)
+{
+    MeshData out;
+    std::vector<Vertex> vertices(mesh->mNumVertices);
+    for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
+        Vertex& v = vertices[i];
+        for (int b = 0; b < MAX_BONE_INFLUENCE; ++b) { v.m_BoneIDs[b] = -1; v.m_Weights[b] = 0.0f; }
+        v.Position = AssimpGLMHelpers::GetGLMVec(mesh->mVertices[i]);
+        v.Normal = mesh->mNormals ? AssimpGLMHelpers::GetGLMVec(mesh->mNormals[i]) : glm::vec3(0.0f, 1.0f, 0.0f);
+        if (mesh->mTextureCoords[0])
+            v.TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+        else
+            v.TexCoords = glm::vec2(0.0f);
+    }
+    for (unsigned int f = 0; f < mesh->mNumFaces; ++f) {
+        const aiFace& face = mesh->mFaces[f];
+        for (unsigned int j = 0; j < face.mNumIndices; ++j) out.indices.push_back(face.mIndices[j]);
+    }
+
+    // main.fs only samples texture_diffuse1, so only the first diffuse map is kept
+    const aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+    if (material->GetTextureCount(aiTextureType_DIFFUSE) > 0) {
+        aiString str;
+        material->GetTexture(aiTextureType_DIFFUSE, 0, &str);
+        out.diffuseTexture = registerTextureFile(data, str.C_Str());
+    }
+
+    extractBoneWeights(data, vertices, mesh);
+    out.vertexCount = (uint32_t)vertices.size();
+    out.skinned = mesh->mNumBones > 0;
+    if (out.skinned) {
+        out.vertices.resize(vertices.size() * sizeof(SkinnedVertex));
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            SkinnedVertex packed = packSkinnedVertex(vertices[i]);
+            std::memcpy(&out.vertices[i * sizeof(SkinnedVertex)], &packed, sizeof(packed));
+        }
+    }
+    else {
+        out.vertices.resize(vertices.size() * sizeof(StaticVertex));
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            StaticVertex packed = packStaticVertex(vertices[i]);
+            std::memcpy(&out.vertices[i * sizeof(StaticVertex)], &packed, sizeof(packed));
+        }
+    }
+    data.meshes.push_back(std::move(out));
+}
+
+static void processNodeData(ModelData& data, const aiNode* node, const aiScene* scene)
+{
+    for (unsigned int i = 0; i < node->mNumMeshes; ++i)
+        processMeshData(data, scene->mMeshes[node->mMeshes[i]], scene);
+    for (unsigned int i = 0; i < node->mNumChildren; ++i)
+        processNodeData(data, node->mChildren[i], scene);
+}
+
+static const unsigned int MODEL_IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_GenSmoothNormals;
+
+// Assimp reads models (and the .mtl files they reference) through the asset
+// layer, so .obj/.dae sources can come out of the resource pack too
+class AssetIOStream : public Assimp::IOStream {
+public:
+    explicit AssetIOStream(AssetBlob b) : blob(std::move(b)) {}
+
+    size_t Read(void* buffer, size_t size, size_t count) override {
+        if (size == 0) return 0;
+        size_t n = std::min(count, (blob.size - pos) / size);
+        std::memcpy(buffer, blob.data + pos, n * size);
+        pos += n * size;
+        return n;
+    }
+    size_t Write(const void*, size_t, size_t) override { return 0; }
+    aiReturn Seek(size_t offset, aiOrigin origin) override {
+        size_t origin_pos = origin == aiOrigin_SET ? 0 : (origin == aiOrigin_CUR ? pos : blob.size);
+        if (offset > blob.size - origin_pos) return aiReturn_FAILURE;
+        pos = origin_pos + offset;
+        return aiReturn_SUCCESS;
+    }
+    size_t Tell() const override { return pos; }
+    size_t FileSize() const override { return blob.size; }
+    void Flush() override {}
+
+private:
+    AssetBlob blob;
+    size_t pos = 0;
+};
+
+class AssetIOSystem : public Assimp::IOSystem {
+public:
+    bool Exists(const char* file) const override { return Assets_Exists(file); }
+    char getOsSeparator() const override { return '/'; }
+    Assimp::IOStream* Open(const char* file, const char* mode = "rb") override {
+        if (std::strchr(mode, 'w') || std::strchr(mode, 'a')) return nullptr;
+        AssetBlob blob;
+        if (!Assets_Open(file, blob)) return nullptr;
+        return new AssetIOStream(std::move(blob));
+    }
+    void Close(Assimp::IOStream* stream) override { delete stream; }
+};
+
+// worker thread: parse a model file (resource-relative path) into CPU-side mesh
+// data; textures are decoded separately
+static bool parseModelFile(const std::string& path, ModelData& data)
+{
+    Assimp::Importer importer;
+    importer.SetIOHandler(new AssetIOSystem); // importer takes ownership
+    const aiScene* scene = importer.ReadFile(path, MODEL_IMPORT_FLAGS);
+    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+        std::cerr << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+    data.path = path;
+    data.directory = path.substr(0, path.find_last_of('/'));
+    processNodeData(data, scene->mRootNode, scene);
+    return true;
+}
+
+// main thread: same sampler setup as TextureFromFile in model_animation.h
+static GLuint createTextureFromImage(const DecodedImage& img)
+{
+    GLenum format = GL_RGB;
+    if (img.channels == 1) format = GL_RED;
+    else if (img.channels == 3) format = GL_RGB;
+    else if (img.channels == 4) format = GL_RGBA;
+
+    GLuint textureID;
+    glGenTextures(1, &textureID);
+    GLState_BindTexture(GL_TEXTURE_2D, textureID);
+    if (img.compressed.data) {
+        uploadCompressedLevels(GL_TEXTURE_2D, img);
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, format, img.width, img.height, 0, format, GL_UNSIGNED_BYTE, img.pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return textureID;
+}
+
+// main thread: upload one mesh in the StaticVertex/SkinnedVertex layout. Locations
+// follow Mesh::setupMesh (0 position, 1 normal, 2 uv, 5 bone ids, 6 weights),
+// which main.vs / depth.vs rely on; 3/4 (tangents) are gone.
+static void uploadRenderMesh(RenderMesh& mesh, const void* vertices, size_t vertexCount, bool skinned,
+                             const unsigned int* indices, size_t indexCount)
+{
+    GLsizei stride = skinned ? sizeof(SkinnedVertex) : sizeof(StaticVertex);
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+
+    GLState_BindVertexArray(mesh.VAO);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * stride, vertices, GL_STATIC_DRAW);
+    GLState_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), indices, GL_STATIC_DRAW);
+
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(StaticVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)offsetof(StaticVertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(StaticVertex, texCoords));
+    if (skinned) {
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(SkinnedVertex, boneIds));
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(SkinnedVertex, weights));
+    }
+    GLState_BindVertexArray(0);
+
+    mesh.indexCount = (GLsizei)indexCount;
+}
+
+// ===================== Baked Meshes =====================
+// Offline-baked, GPU-ready model files (<model>.rrmesh next to the source file),
+// written by `--bake`. Vertex blocks are stored in the StaticVertex/SkinnedVertex
+// layout the VAOs expect, so the runtime maps the file and hands the pointers straight to
+// glBufferData. A baked file whose recorded source size/mtime doesn't match the
+// source is ignored and the text format is parsed instead.
+static const char BAKED_MAGIC[4] = { 'R', 'R', 'M', 'B' };
+static const uint32_t BAKED_VERSION = 3;
+static const size_t BAKED_NAME_LEN = 128;
+
+struct BakedHeader {
+    char     magic[4];
+    uint32_t version;
+    uint32_t vertexStride;   // sizeof(SkinnedVertex) at bake time (layout check)
+    uint32_t meshCount;
+    uint32_t textureCount;
+    uint32_t boneCount;      // bone records
+    int32_t  nextBoneId;     // bone counter after parsing
+    uint64_t sourceSize;
+    int64_t  sourceTime;
+    uint64_t meshTableOffset;
+    uint64_t textureTableOffset;
+    uint64_t boneTableOffset;
+};
+
+struct BakedMesh {
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    int32_t  diffuseTexture;
+    uint32_t skinned;        // SkinnedVertex rather than StaticVertex
+};
+
+struct BakedName { char str[BAKED_NAME_LEN]; };
+
+struct BakedBone {
+    BakedName name;
+    int32_t   id;
+    float     offset[16];
+};
+
+static std::string bakedPathFor(const std::string& sourcePath) { return sourcePath + ".rrmesh"; }
+
+static bool copyBakedName(BakedName& dst, const std::string& src)
+{
+    std::memset(dst.str, 0, sizeof(dst.str));
+    if (src.size() >= BAKED_NAME_LEN) return false;
+    std::memcpy(dst.str, src.data(), src.size());
+    return true;
+}
+
+static std::string readBakedName(const BakedName& n)
+{
+    size_t len = 0;
+    while (len < BAKED_NAME_LEN && n.str[len]) ++len;
+    return std::string(n.str, len);
+}
+
+// offline: parse `sourcePath` and write its .rrmesh
+static bool bakeModelFile(const std::string& sourcePath)
+{
+    ModelData data;
+    if (!parseModelFile(sourcePath, data)) return false;
+
+    BakedHeader header = {};
+    std::memcpy(header.magic, BAKED_MAGIC, sizeof(BAKED_MAGIC));
+    header.version = BAKED_VERSION;
+    header.vertexStride = sizeof(SkinnedVertex);
+    header.meshCount = (uint32_t)data.meshes.size();
+    header.textureCount = (uint32_t)data.textureFiles.size();
+    header.boneCount = (uint32_t)data.boneInfoMap.size();
+    header.nextBoneId = data.boneCount;
+    if (!sourceStamp(FileSystem::getPath(sourcePath), header.sourceSize, header.sourceTime)) return false;
+
+    // layout: header | meshes | textures | bones | vertex/index blocks
+    std::vector<unsigned char> blob;
+    auto reserveBlock = [&](size_t bytes) {
+        size_t offset = (blob.size() + 15) & ~size_t(15); // keep blocks 16-byte aligned
+        blob.resize(offset + bytes);
+        return (uint64_t)offset;
+        };
+    reserveBlock(sizeof(BakedHeader));
+    header.meshTableOffset = reserveBlock(sizeof(BakedMesh) * header.meshCount);
+    header.textureTableOffset = reserveBlock(sizeof(BakedName) * header.textureCount);
+    header.boneTableOffset = reserveBlock(sizeof(BakedBone) * header.boneCount);
+
+    for (uint32_t t = 0; t < header.textureCount; ++t) {
+        BakedName name;
+        if (!copyBakedName(name, data.textureFiles[t])) { std::cerr << "Bake: texture name too long in " << sourcePath << "\n"; return false; }
+        std::memcpy(&blob[header.textureTableOffset + t * sizeof(BakedName)], &name, sizeof(name));
+    }
+
+    uint32_t boneIndex = 0;
+    for (const auto& kv : data.boneInfoMap) {
+        BakedBone bone = {};
+        if (!copyBakedName(bone.name, kv.first)) { std::cerr << "Bake: bone name too long in " << sourcePath << "\n"; return false; }
+        bone.id = kv.second.id;
+        std::memcpy(bone.offset, glm::value_ptr(kv.second.offset), sizeof(bone.offset));
+        std::memcpy(&blob[header.boneTableOffset + (boneIndex++) * sizeof(BakedBone)], &bone, sizeof(bone));
+    }
+
+    for (uint32_t m = 0; m < header.meshCount; ++m) {
+        const MeshData& md = data.meshes[m];
+        BakedMesh mesh = {};
+        mesh.vertexCount = md.vertexCount;
+        mesh.skinned = md.skinned ? 1 : 0;
+        mesh.indexCount = (uint32_t)md.indices.size();
+        mesh.diffuseTexture = md.diffuseTexture;
+        mesh.vertexOffset = reserveBlock(md.vertices.size());
+        if (!md.vertices.empty()) std::memcpy(&blob[mesh.vertexOffset], md.vertices.data(), md.vertices.size());
+        mesh.indexOffset = reserveBlock(sizeof(unsigned int) * md.indices.size());
+        if (!md.indices.empty()) std::memcpy(&blob[mesh.indexOffset], md.indices.data(), sizeof(unsigned int) * md.indices.size());
+        std::memcpy(&blob[header.meshTableOffset + m * sizeof(BakedMesh)], &mesh, sizeof(mesh));
+    }
+
+    std::memcpy(&blob[0], &header, sizeof(header));
+
+    std::string outPath = FileSystem::getPath(bakedPathFor(sourcePath));
+    std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+    if (!out) { std::cerr << "Bake: cannot write " << outPath << "\n"; return false; }
+    out.write((const char*)blob.data(), (std::streamsize)blob.size());
+    std::cout << "Baked " << sourcePath << " (" << header.meshCount << " meshes, "
+              << header.boneCount << " bones)\n";
+
+    // refresh the model's .rrtex files too (written as a side effect of loading)
+    decodeModelTextures(data);
+    for (auto& img : data.images) if (img.pixels) stbi_image_free(img.pixels);
+    return (bool)out;
+}
+
+// Check a mapped .rrmesh against this build's Vertex layout and, for loose files,
+// against its source's size/mtime (the pack only ever holds current baked files)
+static const BakedHeader* validateBakedFile(const AssetBlob& f, const std::string& sourcePath, bool checkSource)
+{
+    if (f.size < sizeof(BakedHeader)) return nullptr;
+    const BakedHeader* h = (const BakedHeader*)f.data;
+    if (std::memcmp(h->magic, BAKED_MAGIC, sizeof(BAKED_MAGIC)) != 0) return nullptr;
+    if (h->version != BAKED_VERSION || h->vertexStride != sizeof(SkinnedVertex)) return nullptr;
+
+    if (checkSource) {
+        uint64_t size = 0; int64_t time = 0;
+        if (!sourceStamp(FileSystem::getPath(sourcePath), size, time) || size != h->sourceSize || time != h->sourceTime) return nullptr;
+    }
+
+    auto inRange = [&](uint64_t offset, uint64_t bytes) { return offset <= f.size && bytes <= f.size - offset; };
+    if (!inRange(h->meshTableOffset, sizeof(BakedMesh) * (uint64_t)h->meshCount) ||
+        !inRange(h->textureTableOffset, sizeof(BakedName) * (uint64_t)h->textureCount) ||
+        !inRange(h->boneTableOffset, sizeof(BakedBone) * (uint64_t)h->boneCount)) return nullptr;
+
+    const BakedMesh* meshes = (const BakedMesh*)(f.data + h->meshTableOffset);
+    for (uint32_t m = 0; m < h->meshCount; ++m) {
+        uint64_t stride = meshes[m].skinned ? sizeof(SkinnedVertex) : sizeof(StaticVertex);
+        if (!inRange(meshes[m].vertexOffset, stride * meshes[m].vertexCount) ||
+            !inRange(meshes[m].indexOffset, sizeof(unsigned int) * (uint64_t)meshes[m].indexCount)) return nullptr;
+        if (meshes[m].diffuseTexture >= (int32_t)h->textureCount) return nullptr;
+    }
+    return h;
+}
+
+// worker thread: fill `data` from a current .rrmesh (texture names and bones only;
+// vertex/index blocks are read from the blob at upload time). Returns null if
+// there is no usable baked file.
+static std::shared_ptr<AssetBlob> openBakedModel(const std::string& sourcePath, ModelData& data)
+{
+    auto baked = std::make_shared<AssetBlob>();
+    if (!Assets_Open(bakedPathFor(sourcePath), *baked)) return nullptr;
+    bool loose = baked->owner != nullptr;
+    const BakedHeader* h = validateBakedFile(*baked, sourcePath, loose);
+    if (!h) {
+        std::cerr << "Baked file for " << sourcePath << " is stale or invalid, parsing source\n";
+        return nullptr;
+    }
+
+    data.path = sourcePath;
+    data.directory = sourcePath.substr(0, sourcePath.find_last_of('/'));
+    const BakedName* names = (const BakedName*)(baked->data + h->textureTableOffset);
+    for (uint32_t t = 0; t < h->textureCount; ++t) data.textureFiles.push_back(readBakedName(names[t]));
+    const BakedBone* bones = (const BakedBone*)(baked->data + h->boneTableOffset);
+    for (uint32_t b = 0; b < h->boneCount; ++b) {
+        BoneInfo info;
+        info.id = bones[b].id;
+        std::memcpy(glm::value_ptr(info.offset), bones[b].offset, sizeof(bones[b].offset));
+        data.boneInfoMap[readBakedName(bones[b].name)] = info;
+    }
+    data.boneCount = h->nextBoneId;
+    return baked;
+}
+
+// ===================== Skeletal Animation =====================
+// The player's clips and the blending animator that plays them (same interface
+// as learnopengl's Animation/Animator, which can only be built by running
+// Assimp on a file). A clip is a flat node hierarchy, parents first, plus
+// keyframe channels. `--bake` writes each clip as <clip>.rranim next to its
+// source; a current baked file is read straight from the mapping, otherwise
+// the source is parsed with Assimp, the same fallback as .rrmesh.
+struct AnimKey { float time; glm::vec3 value; };
+struct AnimRotationKey { float time; glm::quat value; };
+
+struct AnimChannel {           // keyframes of one node, in ticks
+    std::vector<AnimKey> positions, scales;
+    std::vector<AnimRotationKey> rotations;
+};
+
+struct AnimNode {
+    std::string name;
+    glm::mat4 transform = glm::mat4(1.0f); // rest pose, used when there is no channel
+    int parent = -1;                       // earlier in the list, -1 for the root
+    int channel = -1;
+    int bone = -1;                         // index into the final matrices, -1 if not a bone
+    glm::mat4 offset = glm::mat4(1.0f);    // bone offset (mesh space -> bone space)
+};
+
+class Animation {
+public:
+    float duration = 0.0f, ticksPerSecond = 0.0f;
+    std::vector<AnimNode> nodes;
+    std::vector<AnimChannel> channels;
+
+    float GetTicksPerSecond() const { return ticksPerSecond; }
+    float GetDuration() const { return duration; }
+
+    int findNode(const std::string& name) const
+    {
+        for (size_t i = 0; i < nodes.size(); ++i)
+            if (nodes[i].name == name) return (int)i;
+        return -1;
+    }
+};
+
+// keys[i] .. keys[i + 1] around `time`, and how far between them
+template <typename Key>
+static size_t animKeySpan(const std::vector<Key>& keys, float time, float& factor)
+{
+    size_t i = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const Key& k) { return t < k.time; }) - keys.begin();
+    i = std::min(i > 0 ? i - 1 : 0, keys.size() - 2);
+    float span = keys[i + 1].time - keys[i].time;
+    factor = span > 0.0f ? glm::clamp((time - keys[i].time) / span, 0.0f, 1.0f) : 0.0f;
+    return i;
+}
+
+static glm::vec3 sampleAnimKeys(const std::vector<AnimKey>& keys, float time, const glm::vec3& fallback)
+{
+    if (keys.empty()) return fallback;
+    if (keys.size() == 1) return keys[0].value;
+    float f;
+    size_t i = animKeySpan(keys, time, f);
+    return glm::mix(keys[i].value, keys[i + 1].value, f);
+}
+
+// local transform of a node at `time`: T * R * S from its channel, else its rest pose
+static glm::mat4 sampleAnimNode(const Animation& clip, const AnimNode& node, float time)
+{
+    if (node.channel < 0) return node.transform;
+    const AnimChannel& ch = clip.channels[node.channel];
+    glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+    if (ch.rotations.size() == 1) rotation = ch.rotations[0].value;
+    else if (!ch.rotations.empty()) {
+        float f;
+        size_t i = animKeySpan(ch.rotations, time, f);
+        rotation = glm::normalize(glm::slerp(ch.rotations[i].value, ch.rotations[i + 1].value, f));
+    }
+    return glm::translate(glm::mat4(1.0f), sampleAnimKeys(ch.positions, time, glm::vec3(0.0f))) *
+           glm::mat4_cast(rotation) *
+           glm::scale(glm::mat4(1.0f), sampleAnimKeys(ch.scales, time, glm::vec3(1.0f)));
+}
+
+// Plays one clip, or cross-fades a base clip into a layered one (rotations
+// slerped, translations lerped by `blend`). Times are in ticks and wrap at the
+// clip's duration; the state machine in main reads them back to hand a clip's
+// phase over when it switches.
+class Animator {
+public:
+    static const int MAX_BONES = 100; // matches main.vs / depth.vs
+    float m_CurrentTime = 0.0f, m_CurrentTime2 = 0.0f;
+
+    explicit Animator(Animation* animation) : base(animation), finalMatrices(MAX_BONES, glm::mat4(1.0f)) {}
+
+    void PlayAnimation(Animation* baseClip, Animation* layeredClip, float time, float time2, float blendFactor)
+    {
+        base = baseClip;
+        layered = layeredClip;
+        m_CurrentTime = time;
+        m_CurrentTime2 = time2;
+        blend = blendFactor;
+    }
+
+    void UpdateAnimation(float dt)
+    {
+        if (!base || base->nodes.empty()) return;
+        m_CurrentTime = advance(*base, m_CurrentTime, dt);
+        if (layered) m_CurrentTime2 = advance(*layered, m_CurrentTime2, dt);
+
+        globals.resize(base->nodes.size());
+        for (size_t i = 0; i < base->nodes.size(); ++i) {
+            const AnimNode& node = base->nodes[i];
+            glm::mat4 local = sampleAnimNode(*base, node, m_CurrentTime);
+            if (layered) {
+                int other = layered->findNode(node.name);
+                glm::mat4 layer = other >= 0 ? sampleAnimNode(*layered, layered->nodes[other], m_CurrentTime2) : node.transform;
+                glm::mat4 mixed = glm::mat4_cast(glm::slerp(glm::quat_cast(local), glm::quat_cast(layer), blend));
+                mixed[3] = (1.0f - blend) * local[3] + blend * layer[3];
+                local = mixed;
+            }
+            globals[i] = node.parent >= 0 ? globals[node.parent] * local : local;
+            if (node.bone >= 0 && node.bone < MAX_BONES) finalMatrices[node.bone] = globals[i] * node.offset;
+        }
+    }
+
+    const std::vector<glm::mat4>& GetFinalBoneMatrices() const { return finalMatrices; }
+
+private:
+    Animation* base = nullptr;
+    Animation* layered = nullptr;
+    float blend = 0.0f;
+    std::vector<glm::mat4> globals;
+    std::vector<glm::mat4> finalMatrices;
+
+    static float advance(const Animation& clip, float time, float dt)
+    {
+        time += clip.ticksPerSecond * dt;
+        return clip.duration > 0.0f ? std::fmod(time, clip.duration) : 0.0f;
+    }
+};
+
+// Resolve a clip's nodes against the skeleton's bone map. Channels for nodes
+// the skeleton has no bone for get a new id (with an identity offset), as
+// learnopengl's Animation did, so `skeleton` grows while clips are read.
+static void bindAnimationBones(Animation& clip, Model& skeleton)
+{
+    auto& bones = skeleton.GetBoneInfoMap();
+    for (AnimNode& node : clip.nodes) {
+        if (node.channel >= 0 && !bones.count(node.name)) {
+            BoneInfo info;
+            info.id = skeleton.GetBoneCount()++;
+            info.offset = glm::mat4(1.0f);
+            bones[node.name] = info;
+        }
+        auto it = bones.find(node.name);
+        if (it == bones.end()) continue;
+        node.bone = it->second.id;
+        node.offset = it->second.offset;
+    }
+}
+
+static void readAnimationNodes(Animation& clip, const aiNode* src, int parent)
+{
+    AnimNode node;
+    node.name = src->mName.C_Str();
+    node.transform = AssimpGLMHelpers::ConvertMatrixToGLMFormat(src->mTransformation);
+    node.parent = parent;
+    int index = (int)clip.nodes.size();
+    clip.nodes.push_back(node);
+    for (unsigned int i = 0; i < src->mNumChildren; ++i) readAnimationNodes(clip, src->mChildren[i], index);
+}
+
+// worker thread: the first animation in a source file, via Assimp
+static bool parseAnimationFile(const std::string& path, Animation& clip)
+{
+    Assimp::Importer importer;
+    importer.SetIOHandler(new AssetIOSystem);
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+    if (!scene || !scene->mRootNode || scene->mNumAnimations == 0) {
+        std::cerr << "Animation: cannot read " << path << ": " << importer.GetErrorString() << "\n";
+        return false;
+    }
+    const aiAnimation* anim = scene->mAnimations[0];
+    clip.duration = (float)anim->mDuration;
+    clip.ticksPerSecond = (float)anim->mTicksPerSecond;
+    readAnimationNodes(clip, scene->mRootNode, -1);
+    for (unsigned int c = 0; c < anim->mNumChannels; ++c) {
+        const aiNodeAnim* src = anim->mChannels[c];
+        int node = clip.findNode(src->mNodeName.C_Str());
+        if (node < 0) continue;
+        AnimChannel ch;
+        for (unsigned int i = 0; i < src->mNumPositionKeys; ++i)
+            ch.positions.push_back({ (float)src->mPositionKeys[i].mTime, AssimpGLMHelpers::GetGLMVec(src->mPositionKeys[i].mValue) });
+        for (unsigned int i = 0; i < src->mNumRotationKeys; ++i) {
+            const aiQuaternion& q = src->mRotationKeys[i].mValue;
+            ch.rotations.push_back({ (float)src->mRotationKeys[i].mTime, glm::quat(q.w, q.x, q.y, q.z) });
+        }
+        for (unsigned int i = 0; i < src->mNumScalingKeys; ++i)
+            ch.scales.push_back({ (float)src->mScalingKeys[i].mTime, AssimpGLMHelpers::GetGLMVec(src->mScalingKeys[i].mValue) });
+        clip.nodes[node].channel = (int)clip.channels.size();
+        clip.channels.push_back(std::move(ch));
+    }
+    return true;
+}
+
+// .rranim layout: header | nodes | channels | key blocks. Keys are packed floats:
+// positions/scales as {time, x, y, z}, rotations as {time, w, x, y, z}.
+static const char ANIM_MAGIC[4] = { 'R', 'R', 'A', 'N' };
+static const uint32_t ANIM_VERSION = 1;
+
+struct AnimHeader {
+    char     magic[4];
+    uint32_t version;
+    float    duration;
+    float    ticksPerSecond;
+    uint32_t nodeCount;
+    uint32_t channelCount;
+    uint64_t sourceSize;     // stamp of the source, as in BakedHeader
+    int64_t  sourceTime;
+    uint64_t nodeTableOffset;
+    uint64_t channelTableOffset;
+};
+
+struct BakedAnimNode {
+    BakedName name;
+    float     transform[16];
+    int32_t   parent;
+    int32_t   channel;
+};
+
+struct BakedChannel {
+    uint32_t positionKeys, rotationKeys, scaleKeys, pad;
+    uint64_t keyOffset;
+};
+
+static std::string animPathFor(const std::string& sourcePath) { return sourcePath + ".rranim"; }
+
+// offline: parse `sourcePath` and write its .rranim
+static bool bakeAnimationFile(const std::string& sourcePath)
+{
+    Animation clip;
+    if (!parseAnimationFile(sourcePath, clip)) return false;
+
+    AnimHeader header = {};
+    std::memcpy(header.magic, ANIM_MAGIC, sizeof(ANIM_MAGIC));
+    header.version = ANIM_VERSION;
+    header.duration = clip.duration;
+    header.ticksPerSecond = clip.ticksPerSecond;
+    header.nodeCount = (uint32_t)clip.nodes.size();
+    header.channelCount = (uint32_t)clip.channels.size();
+    if (!sourceStamp(FileSystem::getPath(sourcePath), header.sourceSize, header.sourceTime)) return false;
+
+    std::vector<unsigned char> blob;
+    auto reserveBlock = [&](size_t bytes) {
+        size_t offset = (blob.size() + 15) & ~size_t(15);
+        blob.resize(offset + bytes);
+        return (uint64_t)offset;
+        };
+    reserveBlock(sizeof(AnimHeader));
+    header.nodeTableOffset = reserveBlock(sizeof(BakedAnimNode) * header.nodeCount);
+    header.channelTableOffset = reserveBlock(sizeof(BakedChannel) * header.channelCount);
+
+    for (uint32_t n = 0; n < header.nodeCount; ++n) {
+        const AnimNode& node = clip.nodes[n];
+        BakedAnimNode out = {};
+        if (!copyBakedName(out.name, node.name)) { std::cerr << "Bake: node name too long in " << sourcePath << "\n"; return false; }
+        std::memcpy(out.transform, glm::value_ptr(node.transform), sizeof(out.transform));
+        out.parent = node.parent;
+        out.channel = node.channel;
+        std::memcpy(&blob[header.nodeTableOffset + n * sizeof(BakedAnimNode)], &out, sizeof(out));
+    }
+
+    for (uint32_t c = 0; c < header.channelCount; ++c) {
+        const AnimChannel& ch = clip.channels[c];
+        std::vector<float> keys;
+        for (const AnimKey& k : ch.positions) keys.insert(keys.end(), { k.time, k.value.x, k.value.y, k.value.z });
+        for (const AnimRotationKey& k : ch.rotations) keys.insert(keys.end(), { k.time, k.value.w, k.value.x, k.value.y, k.value.z });
+        for (const AnimKey& k : ch.scales) keys.insert(keys.end(), { k.time, k.value.x, k.value.y, k.value.z });
+        BakedChannel out = {};
+        out.positionKeys = (uint32_t)ch.positions.size();
+        out.rotationKeys = (uint32_t)ch.rotations.size();
+        out.scaleKeys = (uint32_t)ch.scales.size();
+        out.keyOffset = reserveBlock(keys.size() * sizeof(float));
+        if (!keys.empty()) std::memcpy(&blob[out.keyOffset], keys.data(), keys.size() * sizeof(float));
+        std::memcpy(&blob[header.channelTableOffset + c * sizeof(BakedChannel)], &out, sizeof(out));
+    }
+
+    std::memcpy(&blob[0], &header, sizeof(header));
+    std::string outPath = FileSystem::getPath(animPathFor(sourcePath));
+    if (!writeFileReplacing(outPath, blob.data(), blob.size())) { std::cerr << "Bake: cannot write " << outPath << "\n"; return false; }
+    std::cout << "Baked " << sourcePath << " (" << header.channelCount << " channels)\n";
+    return true;
+}
+
+// Check a mapped .rranim: every table and key block in range, node links valid,
+// and for loose files the source's size/mtime
+static const AnimHeader* validateAnimationFile(const AssetBlob& f, const std::string& sourcePath, bool checkSource)
+{
+    if (f.size < sizeof(AnimHeader)) return nullptr;
+    const AnimHeader* h = (const AnimHeader*)f.data;
+    if (std::memcmp(h->magic, ANIM_MAGIC, sizeof(ANIM_MAGIC)) != 0 || h->version != ANIM_VERSION) return nullptr;
+
+    if (checkSource) {
+        uint64_t size = 0; int64_t time = 0;
+        if (!sourceStamp(FileSystem::getPath(sourcePath), size, time) || size != h->sourceSize || time != h->sourceTime) return nullptr;
+    }
+
+    auto inRange = [&](uint64_t offset, uint64_t bytes) { return offset <= f.size && bytes <= f.size - offset; };
+    if (!inRange(h->nodeTableOffset, sizeof(BakedAnimNode) * (uint64_t)h->nodeCount) ||
+        !inRange(h->channelTableOffset, sizeof(BakedChannel) * (uint64_t)h->channelCount)) return nullptr;
+
+    const BakedAnimNode* nodes = (const BakedAnimNode*)(f.data + h->nodeTableOffset);
+    for (uint32_t n = 0; n < h->nodeCount; ++n) {
+        if (nodes[n].parent < -1 || nodes[n].parent >= (int32_t)n) return nullptr;
+        if (nodes[n].channel < -1 || nodes[n].channel >= (int32_t)h->channelCount) return nullptr;
+    }
+    const BakedChannel* channels = (const BakedChannel*)(f.data + h->channelTableOffset);
+    for (uint32_t c = 0; c < h->channelCount; ++c) {
+        uint64_t floats = 4 * (uint64_t)channels[c].positionKeys + 5 * (uint64_t)channels[c].rotationKeys + 4 * (uint64_t)channels[c].scaleKeys;
+        if (!inRange(channels[c].keyOffset, floats * sizeof(float))) return nullptr;
+    }
+    return h;
+}
+
+// worker thread: fill `clip` from a current .rranim; false if there is none
+static bool openBakedAnimation(const std::string& sourcePath, Animation& clip)
+{
+    AssetBlob f;
+    if (!Assets_Open(animPathFor(sourcePath), f)) return false;
+    const AnimHeader* h = validateAnimationFile(f, sourcePath, f.owner != nullptr);
+    if (!h) {
+        std::cerr << "Baked animation for " << sourcePath << " is stale or invalid, parsing source\n";
+        return false;
+    }
+
+    clip.duration = h->duration;
+    clip.ticksPerSecond = h->ticksPerSecond;
+    const BakedAnimNode* nodes = (const BakedAnimNode*)(f.data + h->nodeTableOffset);
+    clip.nodes.resize(h->nodeCount);
+    for (uint32_t n = 0; n < h->nodeCount; ++n) {
+        AnimNode& node = clip.nodes[n];
+        node.name = readBakedName(nodes[n].name);
+        std::memcpy(glm::value_ptr(node.transform), nodes[n].transform, sizeof(nodes[n].transform));
+        node.parent = nodes[n].parent;
+        node.channel = nodes[n].channel;
+    }
+    const BakedChannel* channels = (const BakedChannel*)(f.data + h->channelTableOffset);
+    clip.channels.resize(h->channelCount);
+    for (uint32_t c = 0; c < h->channelCount; ++c) {
+        AnimChannel& ch = clip.channels[c];
+        const float* k = (const float*)(f.data + channels[c].keyOffset);
+        for (uint32_t i = 0; i < channels[c].positionKeys; ++i, k += 4) ch.positions.push_back({ k[0], glm::vec3(k[1], k[2], k[3]) });
+        for (uint32_t i = 0; i < channels[c].rotationKeys; ++i, k += 5) ch.rotations.push_back({ k[0], glm::quat(k[1], k[2], k[3], k[4]) });
+        for (uint32_t i = 0; i < channels[c].scaleKeys; ++i, k += 4) ch.scales.push_back({ k[0], glm::vec3(k[1], k[2], k[3]) });
+    }
+    return true;
+}
+
+// worker thread: baked file if present and current, otherwise the source
+static std::unique_ptr<Animation> loadAnimation(const std::string& path, Model& skeleton)
+{
+    auto clip = std::make_unique<Animation>();
+    if (!openBakedAnimation(path, *clip) && !parseAnimationFile(path, *clip)) return clip;
+    bindAnimationBones(*clip, skeleton);
+    return clip;
+}
+
+// ===================== Model Upload =====================
+static std::vector<std::vector<MeshData>> Lod_BuildLevels(const std::vector<MeshData>& geometry); // see Level of Detail
+
+// worker thread: CPU copy of a baked model's meshes, for models that keep
+// their geometry (the upload steps still read vertices straight from `baked`)
+static void readBakedGeometry(const AssetBlob& baked, ModelData& data)
+{
+    const BakedHeader* h = (const BakedHeader*)baked.data;
+    const BakedMesh* table = (const BakedMesh*)(baked.data + h->meshTableOffset);
+    data.meshes.assign(h->meshCount, MeshData());
+    for (uint32_t m = 0; m < h->meshCount; ++m) {
+        const BakedMesh& bm = table[m];
+        MeshData& copy = data.meshes[m];
+        size_t stride = bm.skinned ? sizeof(SkinnedVertex) : sizeof(StaticVertex);
+        copy.vertices.assign(baked.data + bm.vertexOffset, baked.data + bm.vertexOffset + stride * bm.vertexCount);
+        copy.vertexCount = bm.vertexCount;
+        copy.skinned = bm.skinned != 0;
+        const unsigned int* idx = (const unsigned int*)(baked.data + bm.indexOffset);
+        copy.indices.assign(idx, idx + bm.indexCount);
+        copy.diffuseTexture = bm.diffuseTexture;
+    }
+}
+
+// Queue the GL side of a model: one step per texture, one per mesh, and a final
+// step that marks the asset as loaded. `target` must stay at a stable address
+// until loading finishes. For baked models the mesh steps copy straight out of
+// `baked`; a loose baked file is unmapped once the last step has been dropped.
+// Kept geometry and its LODs were prepared by the worker and are only moved in.
+static void Loader_QueueModelUpload(std::shared_ptr<ModelData> data, std::shared_ptr<AssetBlob> baked, RenderModel& target)
+{
+    std::vector<std::function<void()>> steps;
+    RenderModel* model = &target;
+    model->textures.assign(data->images.size(), 0);
+
+    for (size_t i = 0; i < data->images.size(); ++i) {
+        steps.push_back([data, model, i]() {
+            DecodedImage& img = data->images[i];
+            if (!img.loaded()) return;
+            model->textures[i] = createTextureFromImage(img);
+            if (img.pixels) stbi_image_free(img.pixels);
+            img.pixels = nullptr;
+            img.compressed = AssetBlob();
+        });
+    }
+
+    size_t meshCount = baked ? ((const BakedHeader*)baked->data)->meshCount : data->meshes.size();
+    model->meshes.assign(meshCount, RenderMesh());
+    if (model->keepGeometry) model->geometry.assign(meshCount, MeshData());
+    for (size_t m = 0; m < meshCount; ++m) {
+        steps.push_back([data, baked, model, m]() {
+            RenderMesh& mesh = model->meshes[m];
+            int diffuse;
+            if (baked) {
+                const BakedHeader* h = (const BakedHeader*)baked->data;
+                const BakedMesh& bm = ((const BakedMesh*)(baked->data + h->meshTableOffset))[m];
+                uploadRenderMesh(mesh, baked->data + bm.vertexOffset, bm.vertexCount, bm.skinned != 0,
+                                 (const unsigned int*)(baked->data + bm.indexOffset), bm.indexCount);
+                diffuse = bm.diffuseTexture;
+                if (model->keepGeometry) model->geometry[m] = std::move(data->meshes[m]);
+            }
+            else {
+                MeshData& md = data->meshes[m];
+                uploadRenderMesh(mesh, md.vertices.data(), md.vertexCount, md.skinned, md.indices.data(), md.indices.size());
+                diffuse = md.diffuseTexture;
+                if (model->keepGeometry) {
+                    model->geometry[m] = std::move(md);
+                }
+                else {
+                    std::vector<unsigned char>().swap(md.vertices);
+                    std::vector<unsigned int>().swap(md.indices);
+                }
+            }
+            if (diffuse >= 0) mesh.diffuseTexture = model->textures[diffuse];
+        });
+    }
+
+    bool isBaked = baked != nullptr;
+    steps.push_back([data, model, isBaked]() {
+        model->lods = std::move(data->lods);
+        std::cout << "Loaded " << data->path << (isBaked ? " (baked)" : "") << "\n";
+        ++g_assetsDone;
+    });
+
+    Loader_QueueUploads(std::move(steps));
+}
+
+// worker thread: baked file if present and current, otherwise the text format
+static bool loadModelData(const std::string& path, ModelData& data, std::shared_ptr<AssetBlob>& baked)
+{
+    baked = openBakedModel(path, data);
+    if (!baked && !parseModelFile(path, data)) return false;
+    decodeModelTextures(data);
+    return true;
+}
+
+// Start loading one model in the background. The model is counted towards
+// progress immediately; a load failure still completes it (empty) so loading can't stall.
+// keepGeometry must be set before the call: the job builds the LODs for those.
+static void Loader_LoadModelAsync(const std::string& path, RenderModel& target)
+{
+    ++g_assetsTotal;
+    RenderModel* model = &target;
+    bool keepGeometry = target.keepGeometry;
+    Jobs_Submit([path, model, keepGeometry]() {
+        auto data = std::make_shared<ModelData>();
+        std::shared_ptr<AssetBlob> baked;
+        if (!loadModelData(path, *data, baked)) {
+            Loader_QueueUploads({ [] { ++g_assetsDone; } });
+            return;
+        }
+        if (keepGeometry) {
+            if (baked) readBakedGeometry(*baked, *data);
+            data->lods = Lod_BuildLevels(data->meshes);
+        }
+        Loader_QueueModelUpload(data, baked, *model);
+    });
+}
+
+// Player model plus its animation clips. Clips resolve (and extend) the
+// skeleton's bone map, so they're loaded in the same job against `skeleton`,
+// which the main thread doesn't touch until loading is done.
+static void Loader_LoadAnimatedModelAsync(const std::string& path, RenderModel& target, Model& skeleton,
+                                          const std::vector<std::string>& animPaths,
+                                          std::vector<std::unique_ptr<Animation>>& animations)
+{
+    ++g_assetsTotal;
+    animations.resize(animPaths.size());
+    RenderModel* model = &target;
+    Model* skel = &skeleton;
+    std::vector<std::unique_ptr<Animation>>* anims = &animations;
+    Jobs_Submit([path, model, skel, animPaths, anims]() {
+        auto data = std::make_shared<ModelData>();
+        std::shared_ptr<AssetBlob> baked;
+        if (!loadModelData(path, *data, baked)) {
+            Loader_QueueUploads({ [] { ++g_assetsDone; } });
+            return;
+        }
+
+        skel->GetBoneInfoMap() = data->boneInfoMap;
+        skel->GetBoneCount() = data->boneCount;
+        for (size_t i = 0; i < animPaths.size(); ++i)
+            (*anims)[i] = loadAnimation(animPaths[i], *skel);
+
+        Loader_QueueModelUpload(data, baked, *model);
+    });
+}
+
+// Offline step (`RoadRunner --bake`): write a .rrmesh next to every model file,
+// a .rranim next to every player clip and a .rrtex next to every texture the
+// models use, plus the skybox faces
+static int bakeAllModels()
+{
+    g_textureCompression = true; // no GL here; the cache is only read when S3TC is available
+
+    const std::string dir = "resources/objects/RoadRunner/";
+    std::vector<std::string> files = { PLAYER_MODEL_FILE, PLAYER_FALLBACK_MODEL_FILE, SECTION_MODEL_FILE, WIRES_MODEL_FILE };
+    for (const auto* list : { &BUILDING_MODEL_FILES, &CAR_MODEL_FILES, &JUMP_MODEL_FILES, &SLIDE_MODEL_FILES })
+        files.insert(files.end(), list->begin(), list->end());
+    std::sort(files.begin(), files.end());
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+
+    int failures = 0;
+    for (const auto& f : files) {
+        std::string rel = dir + f;
+        if (!Assets_Exists(rel)) continue;
+        if (!bakeModelFile(rel)) { std::cerr << "Bake failed: " << rel << "\n"; ++failures; }
+    }
+    for (const auto& f : PLAYER_ANIMATION_FILES) {
+        std::string rel = dir + f;
+        if (!Assets_Exists(rel)) continue;
+        if (!bakeAnimationFile(rel)) { std::cerr << "Bake failed: " << rel << "\n"; ++failures; }
+    }
+    for (const auto& face : SKYBOX_FACE_FILES) {
+        DecodedImage img;
+        if (!loadTextureImage(face, false, img)) { std::cerr << "Bake failed: " << face << "\n"; ++failures; }
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+// Offline step (`RoadRunner --pack`): copy every file under PACK_DIRECTORIES into
+// PACK_FILE. Run --bake first; stale .rrmesh/.rranim/.rrtex files are left out so the
+// game falls back to the source.
+static int buildResourcePack()
+{
+    struct Entry { std::string name; std::string fullPath; uint64_t size; };
+    std::vector<Entry> entries;
+    const std::string root = FileSystem::getPath("");
+    for (const auto& dir : PACK_DIRECTORIES) {
+        std::error_code ec;
+        for (std::filesystem::recursive_directory_iterator it(FileSystem::getPath(dir), ec), end; it != end; it.increment(ec)) {
+            if (ec || !it->is_regular_file()) continue;
+            std::string full = it->path().generic_string();
+            std::string rel = normalizeAssetPath(std::filesystem::relative(it->path(), root).generic_string());
+            std::string ext = std::filesystem::path(rel).extension().string();
+            if (ext == ".rrmesh" || ext == ".rranim" || ext == ".rrtex") {
+                AssetBlob blob;
+                std::string source = rel.substr(0, rel.size() - ext.size());
+                bool current = Assets_Open(rel, blob) &&
+                    (ext == ".rrmesh" ? validateBakedFile(blob, source, true) != nullptr :
+                     ext == ".rranim" ? validateAnimationFile(blob, source, true) != nullptr :
+                                        validateTextureCache(blob, source, true) != nullptr);
+                if (!current) {
+                    std::cerr << "Pack: skipping stale " << rel << "\n";
+                    continue;
+                }
+            }
+            entries.push_back({ rel, full, (uint64_t)it->file_size() });
+        }
+    }
+
+    uint32_t slotCount = 1;
+    while (slotCount < entries.size() * 2) slotCount <<= 1; // keep probe chains short
+
+    // layout: header | slots | names | file data (16-byte aligned)
+    PackHeader header = {};
+    std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version = PACK_VERSION;
+    header.entryCount = (uint32_t)entries.size();
+    header.slotCount = slotCount;
+    header.slotTableOffset = sizeof(PackHeader);
+    header.nameTableOffset = header.slotTableOffset + sizeof(PackSlot) * (uint64_t)slotCount;
+
+    std::vector<PackSlot> slots(slotCount);
+    std::string names;
+    uint64_t offset = header.nameTableOffset;
+    for (const auto& e : entries) names += e.name;
+    offset += names.size();
+    uint32_t nameOffset = 0;
+    for (const auto& e : entries) {
+        offset = (offset + 15) & ~uint64_t(15);
+        uint64_t hash = fnv1a64(e.name);
+        uint32_t i = (uint32_t)hash & (slotCount - 1);
+        while (slots[i].nameLength != 0) i = (i + 1) & (slotCount - 1);
+        slots[i] = { hash, offset, e.size, nameOffset, (uint32_t)e.name.size() };
+        nameOffset += (uint32_t)e.name.size();
+        offset += e.size;
+    }
+
+    std::string outPath = FileSystem::getPath(PACK_FILE);
+    std::ofstream out(outPath, std::ios::binary | std::ios::trunc);
+    if (!out) { std::cerr << "Pack: cannot write " << outPath << "\n"; return 1; }
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)slots.data(), (std::streamsize)(sizeof(PackSlot) * slots.size()));
+    out.write(names.data(), (std::streamsize)names.size());
+    std::vector<char> buffer;
+    for (const auto& e : entries) {
+        static const char zeros[16] = {};
+        out.write(zeros, (std::streamsize)((16 - (uint64_t)out.tellp() % 16) % 16));
+        std::ifstream in(e.fullPath, std::ios::binary);
+        buffer.resize((size_t)e.size);
+        if (!in.read(buffer.data(), (std::streamsize)e.size)) { std::cerr << "Pack: cannot read " << e.fullPath << "\n"; return 1; }
+        out.write(buffer.data(), (std::streamsize)e.size);
+    }
+    std::cout << "Packed " << entries.size() << " files into " << outPath << "\n";
+    return out ? 0 : 1;
+}
+
+// ===================== Level of Detail =====================
+// Buildings, the road and obstacle models get LOD_COUNT - 1 simplified copies
+// of their geometry, built by their load job on a worker (vertex clustering on
+// progressively coarser grids). Every drawn object - a section batch or an obstacle - picks
+// a level from its projected height on screen. The thresholds have a
+// hysteresis band so objects sitting near one don't flip every frame, and with
+// g_lodCrossFade a switch dithers the old level out while the new one comes in.
+static const int LOD_COUNT = 3;
+// drop to level i + 1 below this projected height (fraction of the screen height)
+static const float LOD_SCREEN_SIZE[LOD_COUNT - 1] = { 0.25f, 0.08f };
+static const float LOD_HYSTERESIS = 0.15f;                            // +-15% around each threshold
+static const float LOD_CELL_SIZE[LOD_COUNT - 1] = { 1.0f / 40.0f, 1.0f / 14.0f }; // fraction of the model's extent
+static const float LOD_FADE_TIME = 0.3f;                              // seconds
+static bool g_lodCrossFade = true;
+
+static glm::vec3 g_lodViewPos(0.0f);
+static float g_lodTanHalfFov = 1.0f;
+static float g_lodBias = 1.0f;                 // > 1 switches to coarser levels sooner (Settings)
+
+struct LodState {
+    int   level = 0;
+    int   previous = 0;     // level being faded out
+    float fade = 1.0f;      // progress from `previous` to `level`, 1 = done
+    bool  started = false;  // first selection snaps without a fade
+};
+
+// Vertex clustering: vertices are snapped to a grid of `cellSize` and merged per
+// cell and dominant normal direction (so hard edges stay hard). Every vertex of
+// a cell moves to the same averaged position, which keeps the result free of
+// cracks; triangles that collapse are dropped.
+static MeshData simplifyMesh(const MeshData& md, float cellSize)
+{
+    if (md.skinned || md.vertexCount == 0 || cellSize <= 0.0f) return md;
+    MeshData out;
+    out.diffuseTexture = md.diffuseTexture;
+    const StaticVertex* src = (const StaticVertex*)md.vertices.data();
+
+    auto cellOf = [&](const StaticVertex& v) {
+        uint64_t key = 0;
+        for (int a = 0; a < 3; ++a)
+            key = (key << 20) | (uint64_t)((int64_t)std::floor(v.position[a] / cellSize) & 0xFFFFF); // 60 bits
+        return key;
+        };
+    std::unordered_map<uint64_t, glm::vec4> cellSum;  // xyz sum, w count
+    for (uint32_t v = 0; v < md.vertexCount; ++v) {
+        glm::vec4& sum = cellSum[cellOf(src[v])];
+        sum += glm::vec4(src[v].position[0], src[v].position[1], src[v].position[2], 1.0f);
+    }
+
+    std::unordered_map<uint64_t, uint32_t> clusterOf;  // (cell, normal direction) -> output vertex
+    std::vector<uint32_t> remap(md.vertexCount);
+    std::vector<StaticVertex> vertices;
+    for (uint32_t v = 0; v < md.vertexCount; ++v) {
+        uint64_t cell = cellOf(src[v]);
+        glm::vec3 n = glm::vec3(glm::unpackSnorm3x10_1x2(src[v].normal));
+        glm::vec3 a = glm::abs(n);
+        int axis = a.x >= a.y && a.x >= a.z ? 0 : (a.y >= a.z ? 1 : 2);
+        uint64_t direction = (uint64_t)(axis * 2 + (n[axis] < 0.0f ? 1 : 0));
+        auto inserted = clusterOf.insert({ cell * 8 + direction, (uint32_t)vertices.size() });
+        if (inserted.second) {
+            StaticVertex rep = src[v]; // keeps the first vertex's normal and UV
+            const glm::vec4& sum = cellSum[cell];
+            rep.position[0] = sum.x / sum.w; rep.position[1] = sum.y / sum.w; rep.position[2] = sum.z / sum.w;
+            vertices.push_back(rep);
+        }
+        remap[v] = inserted.first->second;
+    }
+
+    for (size_t i = 0; i + 2 < md.indices.size(); i += 3) {
+        uint32_t a = remap[md.indices[i]], b = remap[md.indices[i + 1]], c = remap[md.indices[i + 2]];
+        if (a == b || b == c || a == c) continue;
+        out.indices.insert(out.indices.end(), { a, b, c });
+    }
+    out.vertexCount = (uint32_t)vertices.size();
+    out.vertices.assign((const unsigned char*)vertices.data(), (const unsigned char*)(vertices.data() + vertices.size()));
+    return out;
+}
+
+// worker thread: simplified copies of `geometry` for levels 1.., empty if there
+// is nothing to simplify
+static std::vector<std::vector<MeshData>> Lod_BuildLevels(const std::vector<MeshData>& geometry)
+{
+    std::vector<std::vector<MeshData>> lods;
+    glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+    size_t triangles = 0;
+    for (const MeshData& md : geometry) {
+        size_t stride = md.skinned ? sizeof(SkinnedVertex) : sizeof(StaticVertex);
+        for (uint32_t v = 0; v < md.vertexCount; ++v) {
+            const StaticVertex& sv = *(const StaticVertex*)(md.vertices.data() + stride * v);
+            glm::vec3 p(sv.position[0], sv.position[1], sv.position[2]);
+            lo = glm::min(lo, p);
+            hi = glm::max(hi, p);
+        }
+        triangles += md.indices.size() / 3;
+    }
+    if (triangles == 0) return lods;
+    glm::vec3 size = hi - lo;
+    float extent = std::max(size.x, std::max(size.y, size.z));
+    for (int level = 1; level < LOD_COUNT; ++level) {
+        std::vector<MeshData> meshes;
+        for (const MeshData& md : geometry) meshes.push_back(simplifyMesh(md, extent * LOD_CELL_SIZE[level - 1]));
+        lods.push_back(std::move(meshes));
+    }
+    return lods;
+}
+
+// geometry of `level`, falling back to the full meshes
+static const std::vector<MeshData>& Lod_Geometry(const RenderModel& model, int level)
+{
+    if (level <= 0 || level > (int)model.lods.size()) return model.geometry;
+    return model.lods[level - 1];
+}
+
+static size_t Lod_TriangleCount(const std::vector<MeshData>& meshes)
+{
+    size_t n = 0;
+    for (const MeshData& md : meshes) n += md.indices.size() / 3;
+    return n;
+}
+
+// once per frame, before any Lod_Update
+static void Lod_BeginFrame(const glm::vec3& viewPos, float fovyDegrees)
+{
+    g_lodViewPos = viewPos;
+    g_lodTanHalfFov = std::tan(glm::radians(fovyDegrees) * 0.5f);
+}
+
+// projected height of a bounding sphere as a fraction of the screen height
+static float Lod_ScreenSize(const glm::vec3& center, float radius)
+{
+    float distance = std::max(glm::length(center - g_lodViewPos), 0.001f);
+    return radius / (distance * g_lodTanHalfFov * g_lodBias);
+}
+
+static void Lod_Update(LodState& lod, float screenSize, float dt)
+{
+    int level = lod.level;
+    while (level < LOD_COUNT - 1 && screenSize < LOD_SCREEN_SIZE[level] * (1.0f - LOD_HYSTERESIS)) ++level;
+    while (level > 0 && screenSize > LOD_SCREEN_SIZE[level - 1] * (1.0f + LOD_HYSTERESIS)) --level;
+    if (!lod.started) {
+        lod = LodState();
+        lod.level = lod.previous = level;
+        lod.started = true;
+    }
+    else if (level != lod.level) {
+        lod.previous = lod.level;
+        lod.level = level;
+        lod.fade = g_lodCrossFade ? 0.0f : 1.0f;
+    }
+    else {
+        lod.fade = std::min(1.0f, lod.fade + dt / LOD_FADE_TIME);
+    }
+}
+
+// Dither value for the shaders' lodFade: > 0 keeps that share of the pixels,
+// < 0 the complementary share, 0 draws everything
+static bool Lod_Fading(const LodState& lod) { return lod.fade < 1.0f && lod.previous != lod.level; }
+static float Lod_FadeIn(const LodState& lod) { return Lod_Fading(lod) ? std::max(lod.fade, 1.0f / 16.0f) : 0.0f; }
+
+// ===================== Occlusion Culling =====================
+// Hardware occlusion queries against the previous frame's depth. After the
+// scene pass every section and obstacle draws its world bounding box (no color
+// or depth writes) inside a GL_ANY_SAMPLES_PASSED query. The next frames pick
+// the result up once it's available, without waiting; an object whose box
+// passed no samples is left out of the scene pass (it still casts shadows)
+// until a later test sees it again. While a section's result is in flight its
+// draw is wrapped in conditional rendering so the GPU can drop it on its own.
+// Boxes the camera is inside of are not tested.
+static const float OCCLUSION_BOX_MARGIN = 0.5f; // padding, covers the near plane and a frame of motion
+
+struct OcclusionState {
+    GLuint    query = 0;
+    bool      pending = false;     // a test is in flight
+    bool      visible = true;      // last known result
+    glm::vec3 boxMin = glm::vec3(0.0f), boxMax = glm::vec3(0.0f); // world box, set before the test
+};
+
+static std::vector<GLuint> g_freeQueries;
+
+// once per frame, before anything is queued: take a finished result, if any
+static void Occlusion_Poll(OcclusionState& o)
+{
+    if (o.pending) {
+        GLuint available = 0;
+        glGetQueryObjectuiv(o.query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available) {
+            GLuint samples = 0;
+            glGetQueryObjectuiv(o.query, GL_QUERY_RESULT, &samples);
+            o.visible = samples != 0;
+            o.pending = false;
+        }
+    }
+    if (!o.visible) ++g_frameStats.occlusionCulled;
+}
+
+// After the scene pass, with the box program and the [-1, 1] cube VAO bound and
+// color/depth writes off. At most one test per object is in flight.
+static void Occlusion_Test(OcclusionState& o, const glm::vec3& viewPos, ShaderProgram& boxShader)
+{
+    if (o.pending) return;
+    glm::vec3 lo = o.boxMin - glm::vec3(OCCLUSION_BOX_MARGIN);
+    glm::vec3 hi = o.boxMax + glm::vec3(OCCLUSION_BOX_MARGIN);
+    if (viewPos.x >= lo.x && viewPos.x <= hi.x && viewPos.y >= lo.y && viewPos.y <= hi.y &&
+        viewPos.z >= lo.z && viewPos.z <= hi.z) {
+        o.visible = true;
+        return;
+    }
+    if (!o.query) {
+        if (!g_freeQueries.empty()) { o.query = g_freeQueries.back(); g_freeQueries.pop_back(); }
+        else glGenQueries(1, &o.query);
+    }
+    glm::mat4 M = glm::translate(glm::mat4(1.0f), (lo + hi) * 0.5f);
+    M = glm::scale(M, (hi - lo) * 0.5f);
+    boxShader.setMat4("model", M);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, o.query);
+    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    o.pending = true;
+    ++g_frameStats.occlusionTested;
+}
+
+// the object goes away: its query goes back to the pool
+static void Occlusion_Release(OcclusionState& o)
+{
+    if (o.query) g_freeQueries.push_back(o.query);
+    o = OcclusionState();
+}
+
+// World AABB of a local box under M
+static void transformBox(const glm::mat4& M, const glm::vec3& lo, const glm::vec3& hi, glm::vec3& outLo, glm::vec3& outHi)
+{
+    outLo = glm::vec3(std::numeric_limits<float>::max());
+    outHi = glm::vec3(-std::numeric_limits<float>::max());
+    for (int c = 0; c < 8; ++c) {
+        glm::vec3 corner((c & 1) ? hi.x : lo.x, (c & 2) ? hi.y : lo.y, (c & 4) ? hi.z : lo.z);
+        glm::vec3 p = glm::vec3(M * glm::vec4(corner, 1.0f));
+        outLo = glm::min(outLo, p);
+        outHi = glm::max(outHi, p);
+    }
+}
+
+// ===================== Game Structures =====================
+enum class ObstacleType { None, Car, Jump, Slide, Wires };
+
+struct Obstacle {
+    ObstacleType type = ObstacleType::None;
+    glm::vec3    pos;    // world position
+    int          lane;   // 0..2 (index into lateral lanes along Z)
+    int          variantIndex = -1; // which model variant to render
+    uint32_t     id = 0;  // unique per spawned obstacle (traffic audio)
+    LodState     lod;
+    OcclusionState occlusion;
+};
+
+struct Section {
+    float centerX;                // center x position of the section (forward axis)
+    std::array<Obstacle, LANE_COUNT> laneObstacles; // one obstacle slot per lane
+    bool hasWires = false;
+    // building variants for this section: left front, left back, right front, right back
+    std::array<int, 4> buildingVariants;  // FIXED: Changed ) to >
+    int batch = -1;  // merged road + buildings (see Static Batching)
+    LodState lod;
+    OcclusionState occlusion;
+};
+
+// ===================== Player =====================
+struct Player {
+    glm::vec3 pos;
+    int laneIndex = 1;
+    float laneSwitchTimer = 0.0f;
+
+    // Jump / Slide state
+    bool isJumping = false;
+    float jumpTimer = 0.0f;
+    static constexpr float jumpDuration = 0.8f;
+    static constexpr float jumpHeight = 5.0f;
+
+    // NEW: Track root motion offset from animation
+    glm::vec3 animationRootOffset = glm::vec3(0.0f);
+    glm::vec3 lastAnimationRootPos = glm::vec3(0.0f);
+
+    bool isSliding = false;
+    float slideTimer = 0.0f;
+    static constexpr float slideDuration = 0.6f;  // Fixed duration - slide stops automatically
+
+    // Lane change animation state
+    bool isSidestepping = false;
+    float sidestepTimer = 0.0f;
+    static constexpr float sidestepDuration = 0.3f;  // Duration of sidestep animation
+    int sidestepDirection = 0;  // -1 for left, +1 for right, 0 for none
+    float sidestepStartZ = 0.0f;  // Starting Z position for interpolation
+    float sidestepTargetZ = 0.0f;  // Target Z position for interpolation
+
+    // Crouch state (held while S pressed)
+    bool isCrouching = false;
+
+    // Score tracking
+    int score = 0;
+    float lastScoreUpdateX = 0.0f;
+
+    void startJump() {
+        if (!isJumping && !isSliding && !isSidestepping) {
+            isJumping = true;
+            jumpTimer = 0.0f;
+            animationRootOffset = glm::vec3(0.0f);
+            lastAnimationRootPos = glm::vec3(0.0f);
+        }
+    }
+
+    void startSlide() {
+        if (!isSliding && !isJumping && !isSidestepping) {
+            isSliding = true;
+            slideTimer = 0.0f;
+            animationRootOffset = glm::vec3(0.0f);
+            lastAnimationRootPos = glm::vec3(0.0f);
+            std::cout << "*** SLIDE STARTED ***\n";
+        }
+    }
+
+    void startSidestep(int direction, float currentZ, float targetZ) {
+        if (!isSidestepping && !isJumping && !isSliding) {
+            isSidestepping = true;
+            sidestepTimer = 0.0f;
+            sidestepDirection = direction;
+            sidestepStartZ = currentZ;
+            sidestepTargetZ = targetZ;
+            animationRootOffset = glm::vec3(0.0f);
+            lastAnimationRootPos = glm::vec3(0.0f);
+            std::cout << "*** SIDESTEP " << (direction < 0 ? "LEFT" : "RIGHT") << " STARTED (from " << currentZ << " to " << targetZ << ") ***\n";
+        }
+    }
+
+    void updateScore(float dt) {
+        // Score increases based on distance traveled
+        // Every 10 units of distance = 10 points
+        float distanceTraveled = pos.x - lastScoreUpdateX;
+        if (distanceTraveled >= 10.0f) {
+            score += 10;
+            lastScoreUpdateX = pos.x;
+        }
+    }
+
+    void updateTimers(float dt) {
+        if (isJumping) {
+            jumpTimer += dt;
+            if (jumpTimer >= jumpDuration) {
+                isJumping = false;
+                jumpTimer = 0.0f;
+                animationRootOffset = glm::vec3(0.0f);
+            }
+        }
+        if (isSliding) {
+            slideTimer += dt;
+            if (slideTimer >= slideDuration) {
+                isSliding = false;
+                slideTimer = 0.0f;
+                animationRootOffset = glm::vec3(0.0f);
+                std::cout << "*** SLIDE ENDED ***\n";
+                Audio_StopSlide();
+                Audio_PlayRunningLoop();
+            }
+        }
+        if (isSidestepping) {
+            sidestepTimer += dt;
+            if (sidestepTimer >= sidestepDuration) {
+                isSidestepping = false;
+                sidestepTimer = 0.0f;
+                sidestepDirection = 0;
+                animationRootOffset = glm::vec3(0.0f);
+                // Snap to final target position when animation ends
+                pos.z = sidestepTargetZ;
+                std::cout << "*** SIDESTEP ENDED (final Z: " << pos.z << ") ***\n";
+            }
+        }
+        if (laneSwitchTimer > 0.0f) laneSwitchTimer = std::max(0.0f, laneSwitchTimer - dt);
+    }
+};
+
+// ===================== World =====================
+static std::vector<Section> sections;
+static Player player;
+
+// Keep track of which section index the player is currently in (sections are laid out increasing in X)
+static int currentSectionIndex = 0;
+
+// Streaming window: sections are requested far enough ahead that each is ready
+// STREAM_LEAD_SECONDS before it can come into view (g_farPlane past the camera)
+// at the current speed, and dropped once they're behind the camera. Worker jobs
+// generate and merge them; the main thread only adds finished ones, at most
+// STREAM_SECTIONS_PER_FRAME a frame, through the upload queue.
+static const float STREAM_LEAD_SECONDS = 2.0f;
+static const int   STREAM_SECTIONS_PER_FRAME = 1;
+static const float STREAM_TRAIL_DISTANCE = CAM_DISTANCE + SECTION_LENGTH; // behind the player
+
+// Game spawn/reset positions
+static glm::vec3 worldStartCenter(0.0f, 0.0f, 0.0f);
+static glm::vec3 playerSpawnPos;
+
+// Utility: lane Z coordinate (lateral)
+static float laneZ(int idx) {
+    return (idx - 1) * LANE_Z_SPACING; // idx 0 -> -spacing, 1->0, 2->+spacing
+}
+
+// Helper to pick a variant index safely
+static int pickVariantIndex(size_t count) {
+    if (count == 0) return -1;
+    int idx = static_cast<int>(std::floor(uni01(rng) * float(count)));
+    if (idx < 0) idx = 0;
+    if (idx >= (int)count) idx = (int)count - 1;
+    return idx;
+}
+
+// Helper to stringify obstacle type
+static const char* obstacleTypeName(ObstacleType t) {
+    switch (t) {
+    case ObstacleType::None: return "None";
+    case ObstacleType::Car:  return "Car";
+    case ObstacleType::Jump: return "Jump";
+    case ObstacleType::Slide: return "Slide";
+    case ObstacleType::Wires: return "Wires";
+    default: return "Unknown";
+    }
+}
+
+// ===================== Texture Arrays =====================
+// Section batches and obstacle families sample all their textures from a set of
+// texture arrays, one per distinct size, format and mip count. Textures go in as
+// stored: every level is copied over unchanged (S3TC blocks stay compressed,
+// nothing is resampled) and the source textures are deleted afterwards. A draw
+// binds its set from unit TEXTURE_ARRAY_UNIT on (0 is the plain texture, 1 the
+// shadow map) and each vertex names its material: 0 for white, otherwise
+// 1 + (array << 16 | layer). main.fs picks the array. A texture whose group
+// doesn't fit in the set is the exception: it is resampled into the closest
+// existing group instead.
+static const int MAX_TEXTURE_ARRAYS = 6;  // matches main.fs
+static const int TEXTURE_ARRAY_UNIT = 2;
+
+struct TextureArraySet {
+    GLuint arrays[MAX_TEXTURE_ARRAYS] = {};
+    int    count = 0;
+};
+
+// bilinear resize of an RGBA8 image (a 2:1 step is a 2x2 box filter)
+static std::vector<unsigned char> resampleRgba(const std::vector<unsigned char>& src, int sw, int sh, int dw, int dh)
+{
+    std::vector<unsigned char> dst((size_t)dw * dh * 4);
+    for (int y = 0; y < dh; ++y) {
+        float fy = std::max(0.0f, (y + 0.5f) * sh / dh - 0.5f);
+        int y0 = std::min((int)fy, sh - 1), y1 = std::min(y0 + 1, sh - 1);
+        float ty = fy - y0;
+        for (int x = 0; x < dw; ++x) {
+            float fx = std::max(0.0f, (x + 0.5f) * sw / dw - 0.5f);
+            int x0 = std::min((int)fx, sw - 1), x1 = std::min(x0 + 1, sw - 1);
+            float tx = fx - x0;
+            for (int c = 0; c < 4; ++c) {
+                float top = src[((size_t)y0 * sw + x0) * 4 + c] * (1.0f - tx) + src[((size_t)y0 * sw + x1) * 4 + c] * tx;
+                float bottom = src[((size_t)y1 * sw + x0) * 4 + c] * (1.0f - tx) + src[((size_t)y1 * sw + x1) * 4 + c] * tx;
+                dst[((size_t)y * dw + x) * 4 + c] = (unsigned char)(top * (1.0f - ty) + bottom * ty + 0.5f);
+            }
+        }
+    }
+    return dst;
+}
+
+// main thread: copy `sources` into new arrays of `set` and delete them. Returns
+// the material of each source (0 only if the set was already full).
+static std::vector<uint32_t> TextureArrays_Build(TextureArraySet& set, const std::vector<GLuint>& sources)
+{
+    struct Group {
+        GLint width = 0, height = 0, format = 0, levels = 0;
+        bool compressed = false;
+        std::vector<size_t> members;   // indices into sources, in layer order
+        std::vector<size_t> resampled; // layered after members, converted to this group's size/format
+    };
+    struct Overflow { size_t source; GLint width, height, format; };
+    std::vector<Group> groups;
+    std::vector<Overflow> overflow;
+    std::vector<uint32_t> materials(sources.size(), 0);
+    for (size_t i = 0; i < sources.size(); ++i) {
+        Group g;
+        GLint compressed = 0;
+        GLState_BindTexture(GL_TEXTURE_2D, sources[i]);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &g.width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &g.height);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &g.format);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+        g.compressed = compressed != 0;
+        for (g.levels = 1; g.levels < 16; ++g.levels) {
+            GLint w = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, g.levels, GL_TEXTURE_WIDTH, &w);
+            if (w == 0) break;
+        }
+
+        auto it = std::find_if(groups.begin(), groups.end(), [&](const Group& o) {
+            return o.width == g.width && o.height == g.height && o.format == g.format && o.levels == g.levels;
+            });
+        if (it == groups.end()) {
+            if (set.count + (int)groups.size() >= MAX_TEXTURE_ARRAYS) {
+                overflow.push_back({ i, g.width, g.height, g.format });
+                continue;
+            }
+            groups.push_back(g);
+            it = groups.end() - 1;
+        }
+        uint32_t array = (uint32_t)(set.count + (it - groups.begin()));
+        materials[i] = 1 + ((array << 16) | (uint32_t)it->members.size());
+        it->members.push_back(i);
+    }
+
+    // no array left for these: resample each into the group closest in size,
+    // preferring one with the same format (so alpha survives)
+    for (const Overflow& o : overflow) {
+        Group* best = nullptr;
+        float bestScore = 0.0f;
+        for (Group& g : groups) {
+            if (g.compressed && g.format != GL_COMPRESSED_RGB_S3TC_DXT1_EXT && g.format != GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) continue;
+            float score = std::abs(std::log2((float)g.width * g.height / ((float)o.width * o.height))) + (g.format == o.format ? 0.0f : 100.0f);
+            if (!best || score < bestScore) { best = &g; bestScore = score; }
+        }
+        if (!best) {
+            std::cerr << "Texture arrays: no array left for a " << o.width << "x" << o.height << " texture, drawn white\n";
+            continue;
+        }
+        std::cout << "Texture arrays: resampling a " << o.width << "x" << o.height << " texture to " << best->width << "x" << best->height << "\n";
+        uint32_t array = (uint32_t)(set.count + (best - &groups[0]));
+        materials[o.source] = 1 + ((array << 16) | (uint32_t)(best->members.size() + best->resampled.size()));
+        best->resampled.push_back(o.source);
+    }
+
+    std::vector<unsigned char> level;
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    for (const Group& g : groups) {
+        GLuint array;
+        glGenTextures(1, &array);
+        GLState_BindTexture(GL_TEXTURE_2D_ARRAY, array);
+        for (GLint l = 0; l < g.levels; ++l)
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, l, g.format, std::max(1, g.width >> l), std::max(1, g.height >> l),
+                         (GLsizei)(g.members.size() + g.resampled.size()), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, g.levels - 1);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, g.levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        for (size_t layer = 0; layer < g.members.size(); ++layer)
+            for (GLint l = 0; l < g.levels; ++l) {
+                GLsizei w = std::max(1, g.width >> l), h = std::max(1, g.height >> l);
+                GLState_BindTexture(GL_TEXTURE_2D, sources[g.members[layer]]);
+                if (g.compressed) {
+                    GLint size = 0;
+                    glGetTexLevelParameteriv(GL_TEXTURE_2D, l, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &size);
+                    level.resize((size_t)size);
+                    glGetCompressedTexImage(GL_TEXTURE_2D, l, level.data());
+                    GLState_BindTexture(GL_TEXTURE_2D_ARRAY, array);
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, (GLint)layer, w, h, 1, (GLenum)g.format, size, level.data());
+                }
+                else {
+                    level.resize((size_t)w * h * 4);
+                    glGetTexImage(GL_TEXTURE_2D, l, GL_RGBA, GL_UNSIGNED_BYTE, level.data());
+                    GLState_BindTexture(GL_TEXTURE_2D_ARRAY, array);
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, (GLint)layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, level.data());
+                }
+            }
+
+        // overflow layers: level 0 read back as RGBA (GL decompresses), resized to
+        // the group, then mipmapped on the CPU and re-encoded if the group is S3TC
+        for (size_t r = 0; r < g.resampled.size(); ++r) {
+            GLint layer = (GLint)(g.members.size() + r), sw = 0, sh = 0;
+            GLState_BindTexture(GL_TEXTURE_2D, sources[g.resampled[r]]);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &sw);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &sh);
+            level.resize((size_t)sw * sh * 4);
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, level.data());
+            std::vector<unsigned char> pixels = resampleRgba(level, sw, sh, g.width, g.height);
+            GLState_BindTexture(GL_TEXTURE_2D_ARRAY, array);
+
+            if (g.compressed) {
+                DecodedImage img;
+                img.width = g.width;
+                img.height = g.height;
+                img.channels = g.format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ? 4 : 3;
+                if (img.channels == 3)
+                    for (size_t p = 0; p < (size_t)g.width * g.height; ++p)
+                        std::memmove(&pixels[p * 3], &pixels[p * 4], 3);
+                img.pixels = pixels.data();
+                std::vector<unsigned char> encoded = encodeTextureCache(img, 0, 0, 0);
+                const TexCacheLevel* levels = (const TexCacheLevel*)(encoded.data() + sizeof(TexCacheHeader));
+                for (GLint l = 0; l < g.levels; ++l)
+                    glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, layer, (GLsizei)levels[l].width, (GLsizei)levels[l].height, 1,
+                                              (GLenum)g.format, (GLsizei)levels[l].size, encoded.data() + levels[l].offset);
+                continue;
+            }
+            int w = g.width, h = g.height;
+            for (GLint l = 0; l < g.levels; ++l) {
+                if (l > 0) {
+                    int nw = std::max(1, w / 2), nh = std::max(1, h / 2);
+                    pixels = resampleRgba(pixels, w, h, nw, nh);
+                    w = nw; h = nh;
+                }
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, l, 0, 0, layer, w, h, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            }
+        }
+        std::cout << "Texture array: " << g.members.size() + g.resampled.size() << " x " << g.width << "x" << g.height
+                  << (g.compressed ? " (compressed)" : "") << "\n";
+        set.arrays[set.count++] = array;
+    }
+    if (!sources.empty()) GLState_DeleteTextures((GLsizei)sources.size(), sources.data());
+    return materials;
+}
+
+// point a BATCHED/INSTANCED program's texture_arrays[] at their units
+static void setTextureArrayUnits(ShaderProgram& shader)
+{
+    for (int i = 0; i < MAX_TEXTURE_ARRAYS; ++i)
+        shader.setInt("texture_arrays[" + std::to_string(i) + "]", TEXTURE_ARRAY_UNIT + i);
+}
+
+// Bind a set's arrays (before a batched or instanced draw), leaving unit 0 active
+static void TextureArrays_Bind(const TextureArraySet& set)
+{
+    for (int i = 0; i < set.count; ++i) {
+        GLState_ActiveTexture(GL_TEXTURE0 + TEXTURE_ARRAY_UNIT + i);
+        GLState_BindTexture(GL_TEXTURE_2D_ARRAY, set.arrays[i]);
+    }
+    GLState_ActiveTexture(GL_TEXTURE0);
+}
+
+// ===================== Render Queue =====================
+// World draws are queued per pass and sorted by a 64-bit key before they're
+// issued, so program, texture and VAO changes are grouped and opaque geometry
+// goes front to back (early-Z then skips most of what hides behind the
+// building facades). The skybox is in a pass of its own and always goes last.
+//   bits 63..60 pass | 59..52 program | 51..36 material | 35..24 mesh | 23..0 depth
+// Meshes drawn once per frame anyway (section batches) leave the mesh bits at 0
+// so they sort purely by depth.
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// GL 4.3 entry point, loaded by Indirect_Init (null on 3.3 contexts)
+typedef void (APIENTRYP PFN_rrMultiDrawElementsIndirect)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+static PFN_rrMultiDrawElementsIndirect rrMultiDrawElementsIndirect = nullptr;
+
+enum RenderPass { PASS_SHADOW = 0, PASS_OPAQUE = 1, PASS_SKY = 2 };
+
+enum class DrawKind { Elements, ElementsInstanced, Arrays, MultiIndirect };
+
+struct DrawItem {
+    uint64_t       key = 0;
+    DrawKind       kind = DrawKind::Elements;
+    ShaderProgram* program = nullptr;
+    GLuint         vao = 0;
+    GLenum         textureTarget = GL_TEXTURE_2D;
+    GLuint         texture = 0;          // unit 0; 0 = leave whatever is bound
+    const TextureArraySet* textureArrays = nullptr; // batched/instanced materials (see Texture Arrays)
+    GLsizei        count = 0;            // indices (vertices for Arrays, commands for MultiIndirect)
+    size_t         firstIndex = 0;
+    GLint          baseVertex = 0;
+    GLsizei        instances = 0;
+    GLuint         instanceBuffer = 0;
+    size_t         instanceOffset = 0;   // bytes, handed to pointInstances
+    void         (*pointInstances)(size_t offset) = nullptr;
+    GLuint         indirectBuffer = 0;   // MultiIndirect: `count` commands from indirectOffset
+    size_t         indirectOffset = 0;   // bytes
+    bool           hasModel = false;
+    glm::mat4      model = glm::mat4(1.0f);
+    bool           hasLodFade = false;
+    float          lodFade = 0.0f;
+    GLenum         depthFunc = GL_LESS;
+    GLuint         conditionQuery = 0;   // draw only if this occlusion query passed (no wait)
+};
+
+static std::vector<DrawItem> g_renderQueue;
+static glm::vec3 g_renderViewPos(0.0f);
+
+// once per frame, before anything is queued
+static void RenderQueue_BeginFrame(const glm::vec3& viewPos) { g_renderViewPos = viewPos; }
+
+static float RenderQueue_Distance(const glm::vec3& p) { return glm::length(p - g_renderViewPos); }
+
+static uint64_t RenderQueue_Key(RenderPass pass, const ShaderProgram& program, GLuint material, GLuint mesh, float distance)
+{
+    uint64_t depth = (uint64_t)(glm::clamp(distance / g_farPlane, 0.0f, 1.0f) * 16777215.0f);
+    return ((uint64_t)pass << 60) | ((uint64_t)(program.ID & 0xFF) << 52) |
+           ((uint64_t)(material & 0xFFFF) << 36) | ((uint64_t)(mesh & 0xFFF) << 24) | depth;
+}
+
+static void RenderQueue_Submit(const DrawItem& item) { g_renderQueue.push_back(item); }
+
+// Sort and issue everything queued, then empty the queue. Per-frame uniforms
+// (camera, light, bones) must already be set on the programs involved.
+static void RenderQueue_Flush()
+{
+    std::vector<std::pair<uint64_t, uint32_t>> order(g_renderQueue.size());
+    for (size_t i = 0; i < g_renderQueue.size(); ++i) order[i] = { g_renderQueue[i].key, (uint32_t)i };
+    std::sort(order.begin(), order.end());
+
+    for (const auto& entry : order) {
+        const DrawItem& d = g_renderQueue[entry.second];
+        d.program->use();
+        if (d.hasModel) d.program->setMat4("model", d.model);
+        if (d.hasLodFade) d.program->setFloat("lodFade", d.lodFade);
+        GLState_DepthFunc(d.depthFunc);
+        if (d.texture) {
+            GLState_ActiveTexture(GL_TEXTURE0);
+            GLState_BindTexture(d.textureTarget, d.texture);
+        }
+        if (d.textureArrays) TextureArrays_Bind(*d.textureArrays);
+        GLState_BindVertexArray(d.vao);
+        if (d.conditionQuery) glBeginConditionalRender(d.conditionQuery, GL_QUERY_NO_WAIT);
+        switch (d.kind) {
+        case DrawKind::Elements:
+            glDrawElementsBaseVertex(GL_TRIANGLES, d.count, GL_UNSIGNED_INT, (void*)(d.firstIndex * sizeof(unsigned int)), d.baseVertex);
+            break;
+        case DrawKind::ElementsInstanced:
+            GLState_BindBuffer(GL_ARRAY_BUFFER, d.instanceBuffer);
+            d.pointInstances(d.instanceOffset);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, d.count, GL_UNSIGNED_INT,
+                                              (void*)(d.firstIndex * sizeof(unsigned int)), d.instances, d.baseVertex);
+            break;
+        case DrawKind::Arrays:
+            glDrawArrays(GL_TRIANGLES, 0, d.count);
+            break;
+        case DrawKind::MultiIndirect:
+            GLState_BindBuffer(GL_DRAW_INDIRECT_BUFFER, d.indirectBuffer);
+            rrMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)d.indirectOffset, d.count, 0);
+            break;
+        }
+        if (d.conditionQuery) glEndConditionalRender();
+        ++g_frameStats.drawCalls;
+    }
+    GLState_DepthFunc(GL_LESS);
+    g_renderQueue.clear();
+}
+
+// ===================== Static Batching =====================
+// A section's road and four buildings never move relative to each other, so
+// when a section is generated their meshes are merged, in section-local space,
+// into one vertex/index buffer and drawn with a single call. Their textures are
+// moved into texture arrays and each vertex carries its material. All LOD
+// levels go into the same slot, each with its own index range. Every section
+// lives in a fixed-size slot of one shared vertex/index buffer pair (sized for
+// the largest possible section, grown by doubling), so all of them draw from a
+// single VAO; slots of evicted sections go back on a free list and are reused.
+static TextureArraySet g_batchTextures;
+static bool g_batchTexturesBuilt = false;
+
+struct BatchVertex {
+    StaticVertex base;
+    uint32_t     material; // location 7, see Texture Arrays
+};
+
+struct SectionArena {
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    size_t slotVertices = 0, slotIndices = 0; // capacity of one slot, in elements
+    int    slotCount = 0;
+};
+
+struct SectionBatch {                          // one per arena slot
+    GLint   baseVertex = 0;
+    size_t  lodFirst[LOD_COUNT] = {};           // index range of each LOD level
+    GLsizei lodCount[LOD_COUNT] = {};
+    glm::vec3 center = glm::vec3(0.0f);        // section-local bounding sphere
+    float   radius = 0.0f;
+    glm::vec3 boxMin = glm::vec3(0.0f), boxMax = glm::vec3(0.0f); // section-local bounds
+};
+
+static SectionArena g_sectionArena;
+static std::vector<SectionBatch> g_sectionBatches;
+static std::vector<int> g_freeSectionBatches;
+
+// building slots in a section: left front, left back, right front, right back
+static glm::mat4 sectionBuildingTransform(int slot)
+{
+    float roadHalf = ((LANE_COUNT - 1) * LANE_Z_SPACING) + (LANE_Z_SPACING / 2);
+    float x = (slot == 0 || slot == 2) ? BUILDING_LENGTH * 0.5f : -BUILDING_LENGTH * 0.5f;
+    float z = slot < 2 ? -(roadHalf + SIDEWALK_WIDTH) : (roadHalf + SIDEWALK_WIDTH);
+    glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z));
+    if (slot < 2) M = glm::rotate(M, glm::radians(180.0f), glm::vec3(0, 1, 0));
+    return M;
+}
+
+// main thread: move the textures of `models` into `set`; afterwards each model
+// keeps the material of every texture index and no GL textures of its own
+static void moveModelTextures(TextureArraySet& set, const std::vector<RenderModel*>& models)
+{
+    std::vector<GLuint> sources;
+    for (RenderModel* m : models)
+        for (GLuint t : m->textures)
+            if (t) sources.push_back(t);
+    std::vector<uint32_t> materials = TextureArrays_Build(set, sources);
+    size_t next = 0;
+    for (RenderModel* m : models) {
+        m->materials.assign(m->textures.size(), 0);
+        for (size_t t = 0; t < m->textures.size(); ++t)
+            if (m->textures[t]) { m->materials[t] = materials[next++]; m->textures[t] = 0; }
+        for (RenderMesh& mesh : m->meshes) mesh.diffuseTexture = 0;
+    }
+}
+
+// main thread, once loading is done: the road and building models are only ever
+// drawn batched, so their textures all move into g_batchTextures
+static void Batches_BuildTextureArray()
+{
+    std::vector<RenderModel*> models = { &modelSection };
+    for (auto& b : modelBuildings) models.push_back(&b);
+    moveModelTextures(g_batchTextures, models);
+    g_batchTexturesBuilt = true;
+    std::cout << "Section texture arrays: " << g_batchTextures.count << "\n";
+}
+
+static uint32_t modelMaterial(const RenderModel& model, int texture)
+{
+    return texture >= 0 && texture < (int)model.materials.size() ? model.materials[texture] : 0;
+}
+
+static void appendBatchModel(const RenderModel& model, int level, const glm::mat4& M,
+                             std::vector<BatchVertex>& vertices, std::vector<unsigned int>& indices)
+{
+    glm::mat3 N(M); // rotation only
+    for (const MeshData& md : Lod_Geometry(model, level)) {
+        if (md.skinned) continue;
+        uint32_t material = modelMaterial(model, md.diffuseTexture);
+        unsigned int base = (unsigned int)vertices.size();
+        const StaticVertex* src = (const StaticVertex*)md.vertices.data();
+        for (uint32_t v = 0; v < md.vertexCount; ++v) {
+            BatchVertex out;
+            out.base = src[v];
+            glm::vec4 p = M * glm::vec4(src[v].position[0], src[v].position[1], src[v].position[2], 1.0f);
+            out.base.position[0] = p.x; out.base.position[1] = p.y; out.base.position[2] = p.z;
+            glm::vec3 n = N * glm::vec3(glm::unpackSnorm3x10_1x2(src[v].normal));
+            out.base.normal = glm::packSnorm3x10_1x2(glm::vec4(n.x, n.y, n.z, 0.0f));
+            out.material = material;
+            vertices.push_back(out);
+        }
+        for (unsigned int i : md.indices) indices.push_back(base + i);
+    }
+}
+
+// attributes 0-2 and 7 of a BatchVertex buffer bound to GL_ARRAY_BUFFER
+static void setupBatchVertexAttributes()
+{
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(StaticVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(BatchVertex), (void*)offsetof(StaticVertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)offsetof(StaticVertex, texCoords));
+    glEnableVertexAttribArray(7);
+    glVertexAttribIPointer(7, 1, GL_UNSIGNED_INT, sizeof(BatchVertex), (void*)offsetof(BatchVertex, material));
+}
+
+static void countBatchGeometry(const RenderModel& model, int level, size_t& vertices, size_t& indices)
+{
+    for (const MeshData& md : Lod_Geometry(model, level)) {
+        if (md.skinned) continue;
+        vertices += md.vertexCount;
+        indices += md.indices.size();
+    }
+}
+
+// Double the arena (or create it), copying the slots in use
+static void Batches_GrowArena()
+{
+    SectionArena& a = g_sectionArena;
+    if (a.slotVertices == 0) {
+        // the road plus the largest building in all four slots, every LOD level
+        for (int level = 0; level < LOD_COUNT; ++level) {
+            countBatchGeometry(modelSection, level, a.slotVertices, a.slotIndices);
+            size_t maxVertices = 0, maxIndices = 0;
+            for (const auto& b : modelBuildings) {
+                size_t v = 0, i = 0;
+                countBatchGeometry(b, level, v, i);
+                maxVertices = std::max(maxVertices, v);
+                maxIndices = std::max(maxIndices, i);
+            }
+            a.slotVertices += 4 * maxVertices;
+            a.slotIndices += 4 * maxIndices;
+        }
+        glGenVertexArrays(1, &a.VAO);
+    }
+
+    int newCount = std::max(8, a.slotCount * 2);
+    GLuint vbo, ebo;
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    GLState_BindVertexArray(a.VAO);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, newCount * a.slotVertices * sizeof(BatchVertex), nullptr, GL_STATIC_DRAW);
+    GLState_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, newCount * a.slotIndices * sizeof(unsigned int), nullptr, GL_STATIC_DRAW);
+    if (a.slotCount > 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, a.VBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0, a.slotCount * a.slotVertices * sizeof(BatchVertex));
+        glBindBuffer(GL_COPY_READ_BUFFER, a.EBO);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ELEMENT_ARRAY_BUFFER, 0, 0, a.slotCount * a.slotIndices * sizeof(unsigned int));
+        GLuint old[2] = { a.VBO, a.EBO };
+        GLState_DeleteBuffers(2, old);
+    }
+    setupBatchVertexAttributes();
+    a.VBO = vbo;
+    a.EBO = ebo;
+
+    g_sectionBatches.resize(newCount);
+    for (int slot = newCount - 1; slot >= a.slotCount; --slot) {
+        g_sectionBatches[slot].baseVertex = (GLint)(slot * a.slotVertices);
+        g_freeSectionBatches.push_back(slot);
+    }
+    a.slotCount = newCount;
+}
+
+static int Batches_Acquire()
+{
+    if (g_freeSectionBatches.empty()) Batches_GrowArena();
+    int slot = g_freeSectionBatches.back();
+    g_freeSectionBatches.pop_back();
+    return slot;
+}
+
+// Return a section's slot to the free list (call before dropping the section)
+static void Batches_Release(Section& s)
+{
+    if (s.batch < 0) return;
+    g_freeSectionBatches.push_back(s.batch);
+    s.batch = -1;
+}
+
+struct SectionGeometry {                       // a merged section, ready to upload
+    std::vector<BatchVertex> vertices;
+    std::vector<unsigned int> indices;
+    size_t  lodFirst[LOD_COUNT] = {};           // relative to the slot's first index
+    GLsizei lodCount[LOD_COUNT] = {};
+    glm::vec3 boxMin = glm::vec3(0.0f), boxMax = glm::vec3(0.0f);
+};
+
+// worker thread: merge the section's road + buildings. Only reads the models'
+// kept geometry and materials, which don't change once loading is done.
+static void Batches_MergeSection(const Section& s, SectionGeometry& g)
+{
+    for (int level = 0; level < LOD_COUNT; ++level) {
+        g.lodFirst[level] = g.indices.size();
+        appendBatchModel(modelSection, level, glm::mat4(1.0f), g.vertices, g.indices);
+        for (int i = 0; i < 4; ++i) {
+            int vid = s.buildingVariants[i];
+            if (vid >= 0 && vid < (int)modelBuildings.size())
+                appendBatchModel(modelBuildings[vid], level, sectionBuildingTransform(i), g.vertices, g.indices);
+        }
+        g.lodCount[level] = (GLsizei)(g.indices.size() - g.lodFirst[level]);
+
+        if (level == 0 && !g.vertices.empty()) {
+            glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+            for (const BatchVertex& v : g.vertices) {
+                lo = glm::min(lo, glm::vec3(v.base.position[0], v.base.position[1], v.base.position[2]));
+                hi = glm::max(hi, glm::vec3(v.base.position[0], v.base.position[1], v.base.position[2]));
+            }
+            g.boxMin = lo;
+            g.boxMax = hi;
+        }
+    }
+}
+
+// main thread: copy a merged section into a (recycled) arena slot
+static void Batches_UploadSection(Section& s, const SectionGeometry& g)
+{
+    if (!g_batchTexturesBuilt) return;
+    s.batch = Batches_Acquire();
+    SectionBatch& b = g_sectionBatches[s.batch];
+    size_t firstIndex = s.batch * g_sectionArena.slotIndices;
+    for (int level = 0; level < LOD_COUNT; ++level) {
+        b.lodFirst[level] = firstIndex + g.lodFirst[level];
+        b.lodCount[level] = g.lodCount[level];
+    }
+    b.center = (g.boxMin + g.boxMax) * 0.5f;
+    b.radius = glm::length(g.boxMax - g.boxMin) * 0.5f;
+    b.boxMin = g.boxMin;
+    b.boxMax = g.boxMax;
+
+    GLState_BindVertexArray(g_sectionArena.VAO);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, g_sectionArena.VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, b.baseVertex * sizeof(BatchVertex), g.vertices.size() * sizeof(BatchVertex), g.vertices.data());
+    GLState_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_sectionArena.EBO);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, firstIndex * sizeof(unsigned int), g.indices.size() * sizeof(unsigned int), g.indices.data());
+}
+
+// once per frame: pick the section's LOD level from its projected size
+static void Batches_UpdateLod(Section& s, float dt)
+{
+    if (s.batch < 0) return;
+    const SectionBatch& b = g_sectionBatches[s.batch];
+    Lod_Update(s.lod, Lod_ScreenSize(b.center + glm::vec3(s.centerX, 0.0f, 0.0f), b.radius), dt);
+}
+
+// Queue a section's merged road + buildings (BATCHED shader variant, or a depth
+// shader for PASS_SHADOW). With `crossFade` a section switching levels queues
+// both, dithered through the lodFade uniform; otherwise only its current level.
+// The scene pass skips sections found occluded (see Occlusion Culling).
+static void Batches_Queue(ShaderProgram& shader, const Section& s, RenderPass pass, bool crossFade = false)
+{
+    if (s.batch < 0) return;
+    if (pass == PASS_OPAQUE && !s.occlusion.visible) return;
+    const SectionBatch& b = g_sectionBatches[s.batch];
+    DrawItem d;
+    d.program = &shader;
+    d.vao = g_sectionArena.VAO;
+    d.baseVertex = b.baseVertex;
+    if (pass != PASS_SHADOW) {
+        d.textureArrays = &g_batchTextures;
+    }
+    d.hasModel = true;
+    d.model = glm::translate(glm::mat4(1.0f), glm::vec3(s.centerX, 0.0f, 0.0f));
+    d.key = RenderQueue_Key(pass, shader, pass != PASS_SHADOW ? g_batchTextures.arrays[0] : 0, 0, RenderQueue_Distance(b.center + glm::vec3(s.centerX, 0.0f, 0.0f)));
+    d.count = b.lodCount[s.lod.level];
+    d.firstIndex = b.lodFirst[s.lod.level];
+    d.hasLodFade = crossFade;
+    d.lodFade = Lod_FadeIn(s.lod);
+    if (pass == PASS_OPAQUE && s.occlusion.pending) d.conditionQuery = s.occlusion.query;
+    RenderQueue_Submit(d);
+    if (crossFade && Lod_Fading(s.lod)) {
+        d.count = b.lodCount[s.lod.previous];
+        d.firstIndex = b.lodFirst[s.lod.previous];
+        d.lodFade = -d.lodFade;
+        RenderQueue_Submit(d);
+    }
+}
+
+// ===================== Instanced Variants =====================
+// Obstacle variant families (cars, jump and slide obstacles) share one VAO and
+// one set of texture arrays per family: every variant's meshes are merged into
+// a family vertex/index buffer and each vertex stores its material. A frame then
+// draws every variant of a family with one instanced call and no texture, VAO or
+// program changes in between. (Collapsing the variants into a single call needs
+// multi-draw indirect, which GL 3.3 doesn't have.) Each LOD level of a variant
+// is a range of its own, so an obstacle's level just picks the range it's
+// queued under. Instances found occluded are collected apart and uploaded after
+// the visible ones, so the scene pass draws a prefix and the shadow pass the
+// whole range.
+struct VariantRange {
+    GLint    baseVertex = 0;
+    size_t   firstIndex = 0;
+    GLsizei  indexCount = 0;
+};
+
+struct VariantInstance {       // per-instance attributes 8..12
+    float    model[16];
+    float    lodFade;          // see Lod_FadeIn
+    uint32_t pad[3];
+};
+
+struct VariantBucket {         // this frame's instances of one range, split by occlusion
+    std::vector<VariantInstance> visible, occluded;
+    std::vector<glm::vec4> visibleBounds, occludedBounds; // world bounding spheres (indirect culling)
+};
+
+struct VariantFamily {
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    TextureArraySet textures;
+    StreamRange instances;                             // this frame's upload (Stream_Upload)
+    std::vector<VariantRange> variants;                // [variant * LOD_COUNT + level]
+    std::vector<glm::vec4> bounds;                     // per variant: local center, radius
+    std::vector<glm::vec3> boxes;                      // per variant: local min, max
+    std::vector<VariantBucket> pending;                // this frame's instances, per range
+    std::vector<float> nearest;                        // closest instance of each range (sort depth)
+    std::vector<size_t> uploadedOffset;                // first instance of each range in the upload
+};
+
+static VariantFamily g_carFamily, g_jumpFamily, g_slideFamily;
+
+// main thread, once loading is done. The models' CPU geometry is released
+// afterwards since nothing else needs it.
+static void Variants_Build(VariantFamily& family, std::vector<RenderModel>& models)
+{
+    std::vector<RenderModel*> textured;
+    for (RenderModel& model : models) textured.push_back(&model);
+    moveModelTextures(family.textures, textured);
+
+    std::vector<BatchVertex> vertices;
+    std::vector<unsigned int> indices;
+    family.variants.assign(models.size() * LOD_COUNT, VariantRange());
+    family.bounds.assign(models.size(), glm::vec4(0.0f));
+    family.boxes.assign(models.size() * 2, glm::vec3(0.0f));
+    for (size_t v = 0; v < models.size(); ++v) {
+        RenderModel& model = models[v];
+        for (int level = 0; level < LOD_COUNT; ++level) {
+            VariantRange& range = family.variants[v * LOD_COUNT + level];
+            range.baseVertex = (GLint)vertices.size();
+            range.firstIndex = indices.size();
+            for (const MeshData& md : Lod_Geometry(model, level)) {
+                if (md.skinned) continue;
+                uint32_t material = modelMaterial(model, md.diffuseTexture);
+                unsigned int base = (unsigned int)(vertices.size() - range.baseVertex);
+                const StaticVertex* src = (const StaticVertex*)md.vertices.data();
+                for (uint32_t i = 0; i < md.vertexCount; ++i) vertices.push_back({ src[i], material });
+                for (unsigned int i : md.indices) indices.push_back(base + i);
+            }
+            range.indexCount = (GLsizei)(indices.size() - range.firstIndex);
+
+            if (level == 0 && range.baseVertex < (GLint)vertices.size()) {
+                glm::vec3 lo(std::numeric_limits<float>::max()), hi(-std::numeric_limits<float>::max());
+                for (size_t i = range.baseVertex; i < vertices.size(); ++i) {
+                    lo = glm::min(lo, glm::vec3(vertices[i].base.position[0], vertices[i].base.position[1], vertices[i].base.position[2]));
+                    hi = glm::max(hi, glm::vec3(vertices[i].base.position[0], vertices[i].base.position[1], vertices[i].base.position[2]));
+                }
+                family.bounds[v] = glm::vec4((lo + hi) * 0.5f, glm::length(hi - lo) * 0.5f);
+                family.boxes[v * 2] = lo;
+                family.boxes[v * 2 + 1] = hi;
+            }
+        }
+        std::vector<MeshData>().swap(model.geometry);
+        std::vector<std::vector<MeshData>>().swap(model.lods);
+    }
+    family.pending.assign(family.variants.size(), VariantBucket());
+    family.nearest.assign(family.variants.size(), g_farPlane);
+    family.uploadedOffset.assign(family.variants.size(), 0);
+    if (vertices.empty()) return;
+
+    glGenVertexArrays(1, &family.VAO);
+    glGenBuffers(1, &family.VBO);
+    glGenBuffers(1, &family.EBO);
+    GLState_BindVertexArray(family.VAO);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, family.VBO);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(BatchVertex), vertices.data(), GL_STATIC_DRAW);
+    setupBatchVertexAttributes();
+    GLState_BindBuffer(GL_ELEMENT_ARRAY_BUFFER, family.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    for (int a = 8; a <= 12; ++a) {
+        glEnableVertexAttribArray(a);
+        glVertexAttribDivisor(a, 1);
+    }
+    GLState_BindVertexArray(0);
+}
+
+// Queue one instance, advance its LOD state and set its occlusion test box; an
+// out-of-range variant falls back to variant 0 (as before). While the obstacle
+// switches levels it is queued under both, with complementary dither.
+static void Variants_Add(VariantFamily& family, int variant, const glm::vec3& pos, float yawDeg, float scale,
+                         LodState& lod, OcclusionState& occlusion, float dt)
+{
+    if (family.variants.empty() || !family.VAO) return;
+    if (variant < 0 || variant >= (int)family.bounds.size()) variant = 0;
+    glm::mat4 M = glm::translate(glm::mat4(1.0f), pos);
+    if (yawDeg != 0.0f) M = glm::rotate(M, glm::radians(yawDeg), glm::vec3(0, 1, 0));
+    M = glm::scale(M, glm::vec3(scale)); // uniform, see queueModelAt
+    const glm::vec4& bounds = family.bounds[variant];
+    glm::vec3 center = glm::vec3(M * glm::vec4(glm::vec3(bounds), 1.0f));
+    Lod_Update(lod, Lod_ScreenSize(center, bounds.w * scale), dt);
+    float distance = RenderQueue_Distance(center);
+
+    VariantInstance inst = {};
+    std::memcpy(inst.model, glm::value_ptr(M), sizeof(inst.model));
+    inst.lodFade = Lod_FadeIn(lod);
+    glm::vec4 sphere(center, bounds.w * scale);
+    transformBox(M, family.boxes[variant * 2], family.boxes[variant * 2 + 1], occlusion.boxMin, occlusion.boxMax);
+
+    auto add = [&](size_t range) {
+        VariantBucket& bucket = family.pending[range];
+        (occlusion.visible ? bucket.visible : bucket.occluded).push_back(inst);
+        (occlusion.visible ? bucket.visibleBounds : bucket.occludedBounds).push_back(sphere);
+        if (occlusion.visible) family.nearest[range] = std::min(family.nearest[range], distance);
+        };
+    add(variant * LOD_COUNT + lod.level);
+    if (Lod_Fading(lod)) {
+        inst.lodFade = -inst.lodFade;
+        add(variant * LOD_COUNT + lod.previous);
+    }
+}
+
+// Upload this frame's instances (once, shared by the shadow and scene passes)
+static void Variants_Upload(VariantFamily& family)
+{
+    if (!family.VAO) return;
+    std::vector<VariantInstance> all;
+    for (size_t v = 0; v < family.pending.size(); ++v) {
+        family.uploadedOffset[v] = all.size();
+        all.insert(all.end(), family.pending[v].visible.begin(), family.pending[v].visible.end());
+        all.insert(all.end(), family.pending[v].occluded.begin(), family.pending[v].occluded.end());
+    }
+    if (all.empty()) return;
+    family.instances = Stream_Upload(all.data(), all.size() * sizeof(VariantInstance));
+}
+
+static void Variants_Clear(VariantFamily& family)
+{
+    for (VariantBucket& bucket : family.pending) {
+        bucket.visible.clear();
+        bucket.occluded.clear();
+        bucket.visibleBounds.clear();
+        bucket.occludedBounds.clear();
+    }
+    std::fill(family.nearest.begin(), family.nearest.end(), g_farPlane);
+}
+
+// Point the per-instance attributes at the instance buffer (bound to
+// GL_ARRAY_BUFFER) from `offset` on; without base-instance draws this happens
+// before every instanced draw
+static void Variants_PointInstances(size_t offset)
+{
+    for (int c = 0; c < 4; ++c)
+        glVertexAttribPointer(8 + c, 4, GL_FLOAT, GL_FALSE, sizeof(VariantInstance),
+                              (void*)(offset + offsetof(VariantInstance, model) + c * 4 * sizeof(float)));
+    glVertexAttribPointer(12, 1, GL_FLOAT, GL_FALSE, sizeof(VariantInstance), (void*)(offset + offsetof(VariantInstance, lodFade)));
+}
+
+// Queue one instanced draw per variant and level with instances (INSTANCED
+// shader variants, or the instanced depth shader for PASS_SHADOW, which also
+// takes the occluded ones)
+static void Variants_Queue(const VariantFamily& family, ShaderProgram& shader, RenderPass pass)
+{
+    if (!family.VAO) return;
+    for (size_t v = 0; v < family.variants.size(); ++v) {
+        const VariantBucket& bucket = family.pending[v];
+        GLsizei count = (GLsizei)(bucket.visible.size() + (pass == PASS_SHADOW ? bucket.occluded.size() : 0));
+        const VariantRange& range = family.variants[v];
+        if (count == 0 || range.indexCount == 0) continue;
+        DrawItem d;
+        d.kind = DrawKind::ElementsInstanced;
+        d.program = &shader;
+        d.vao = family.VAO;
+        if (pass != PASS_SHADOW) {
+            d.textureArrays = &family.textures;
+        }
+        d.key = RenderQueue_Key(pass, shader, pass != PASS_SHADOW ? family.textures.arrays[0] : 0, family.VAO, family.nearest[v]);
+        d.count = range.indexCount;
+        d.firstIndex = range.firstIndex;
+        d.baseVertex = range.baseVertex;
+        d.instances = count;
+        d.instanceBuffer = family.instances.buffer;
+        d.instanceOffset = family.instances.offset + family.uploadedOffset[v] * sizeof(VariantInstance);
+        d.pointInstances = Variants_PointInstances;
+        RenderQueue_Submit(d);
+    }
+}
+
+// ===================== Indirect Drawing =====================
+// GPU-driven path for GL 4.3 contexts. Every section batch level and every
+// obstacle instance becomes a cull record (world bounding sphere + index range)
+// and an entry in one shared instance array (model matrix, LOD
+// fade, fetched through baseInstance); both are streamed up every frame. A compute shader (cull.cs) tests the
+// records against the camera and the light frustum and writes one indirect
+// command per record and frustum, with instanceCount 0 when it's outside. The
+// sections and each obstacle family are then drawn with a single
+// glMultiDrawElementsIndirect per pass, so the CPU cost no longer depends on
+// how many objects are out there. On 3.3 the per-batch/per-variant queue path
+// (Batches_Queue, Variants_Queue) is used instead.
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_COMMAND_BARRIER_BIT
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+#define GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT 0x90DF
+#endif
+
+typedef void (APIENTRYP PFN_rrDispatchCompute)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+typedef void (APIENTRYP PFN_rrMemoryBarrier)(GLbitfield barriers);
+static PFN_rrDispatchCompute rrDispatchCompute = nullptr;
+static PFN_rrMemoryBarrier rrMemoryBarrier = nullptr;
+
+static const GLuint CULL_GROUP_SIZE = 64; // local_size_x in cull.cs
+
+struct CullRecord {            // std430, matches cull.cs
+    float    sphere[4];        // world center, radius
+    uint32_t count;
+    uint32_t firstIndex;
+    int32_t  baseVertex;
+    uint32_t baseInstance;
+    uint32_t occluded;         // dropped from the camera commands (see Occlusion Culling)
+    uint32_t pad[3];
+};
+
+struct DrawCommand {           // GL's DrawElementsIndirectCommand
+    uint32_t count;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    int32_t  baseVertex;
+    uint32_t baseInstance;
+};
+
+struct IndirectGroup {         // one multi-draw: a VAO + texture arrays and its records
+    GLuint VAO = 0;
+    const TextureArraySet* textures = nullptr;
+    size_t firstRecord = 0, recordCount = 0;
+    float  nearest = g_farPlane;
+};
+
+struct IndirectState {
+    bool enabled = false;
+    ShaderProgram* cullShader = nullptr;
+    GLuint commandBuffer = 0;          // written by cull.cs only
+    size_t commandCapacity = 0;        // in commands
+    GLint  storageAlignment = 1;       // for binding records out of the stream buffer
+    std::vector<CullRecord> records;
+    std::vector<VariantInstance> instances;
+    std::vector<IndirectGroup> groups;
+};
+
+static IndirectState g_indirect;
+
+// Gribb/Hartmann: the six planes (xyz normal pointing inward, w distance) of a
+// view-projection matrix, normalized so sphere tests can use the radius directly
+static void extractFrustumPlanes(const glm::mat4& m, glm::vec4 planes[6])
+{
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; ++i) row[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+    planes[0] = row[3] + row[0]; // left
+    planes[1] = row[3] - row[0]; // right
+    planes[2] = row[3] + row[1]; // bottom
+    planes[3] = row[3] - row[1]; // top
+    planes[4] = row[3] + row[2]; // near
+    planes[5] = row[3] - row[2]; // far
+    for (int i = 0; i < 6; ++i) planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+// Point a VAO's per-instance attributes (8..12) at this frame's instance array
+static void Indirect_AttachInstances(GLuint vao, const StreamRange& instances)
+{
+    GLState_BindVertexArray(vao);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, instances.buffer);
+    Variants_PointInstances(instances.offset);
+    GLState_BindVertexArray(0);
+}
+
+// main thread, after Variants_Build. Leaves the path off unless the context is
+// 4.3+ and the cull shader builds.
+static void Indirect_Init()
+{
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    if (major * 10 + minor < 43) {
+        std::cout << "GL " << major << "." << minor << ": indirect drawing off, using the 3.3 path\n";
+        return;
+    }
+    rrMultiDrawElementsIndirect = (PFN_rrMultiDrawElementsIndirect)glfwGetProcAddress("glMultiDrawElementsIndirect");
+    rrDispatchCompute = (PFN_rrDispatchCompute)glfwGetProcAddress("glDispatchCompute");
+    rrMemoryBarrier = (PFN_rrMemoryBarrier)glfwGetProcAddress("glMemoryBarrier");
+    if (!rrMultiDrawElementsIndirect || !rrDispatchCompute || !rrMemoryBarrier) return;
+    g_indirect.cullShader = new ShaderProgram("cull.cs");
+    if (!g_indirect.cullShader->ID) {
+        std::cerr << "Cull shader failed to build, using the 3.3 path\n";
+        delete g_indirect.cullShader;
+        g_indirect.cullShader = nullptr;
+        return;
+    }
+
+    glGenBuffers(1, &g_indirect.commandBuffer);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &g_indirect.storageAlignment);
+    if (g_sectionArena.slotCount == 0) Batches_GrowArena();
+    GLState_BindVertexArray(g_sectionArena.VAO); // families enabled theirs in Variants_Build
+    for (int a = 8; a <= 12; ++a) {
+        glEnableVertexAttribArray(a);
+        glVertexAttribDivisor(a, 1);
+    }
+    GLState_BindVertexArray(0);
+    g_indirect.enabled = true;
+    std::cout << "Indirect drawing on (GL " << major << "." << minor << ")\n";
+}
+
+static void Indirect_AddRecord(const glm::vec4& sphere, GLsizei count, size_t firstIndex, GLint baseVertex,
+                               const VariantInstance& inst, bool occluded)
+{
+    CullRecord r = {};
+    r.sphere[0] = sphere.x; r.sphere[1] = sphere.y; r.sphere[2] = sphere.z; r.sphere[3] = sphere.w;
+    r.count = (uint32_t)count;
+    r.firstIndex = (uint32_t)firstIndex;
+    r.baseVertex = baseVertex;
+    r.baseInstance = (uint32_t)g_indirect.instances.size();
+    r.occluded = occluded ? 1 : 0;
+    g_indirect.records.push_back(r);
+    g_indirect.instances.push_back(inst);
+}
+
+// Once per frame, after the LOD/variant update and before the shadow pass:
+// gather records for the sections and this frame's obstacle instances, upload
+// them and cull against both frusta. Commands [0, n) are for the camera (which
+// also drops occluded records), [n, 2n) for the light.
+static void Indirect_BuildFrame(const glm::mat4& viewProjection, const glm::mat4& lightSpace)
+{
+    IndirectState& ind = g_indirect;
+    ind.records.clear();
+    ind.instances.clear();
+    ind.groups.clear();
+
+    // sections: both levels while cross-fading, as Batches_Queue does for the scene
+    IndirectGroup sectionGroup;
+    sectionGroup.VAO = g_sectionArena.VAO;
+    sectionGroup.textures = &g_batchTextures;
+    for (const Section& s : sections) {
+        if (s.batch < 0) continue;
+        const SectionBatch& b = g_sectionBatches[s.batch];
+        glm::vec3 center = b.center + glm::vec3(s.centerX, 0.0f, 0.0f);
+        VariantInstance inst = {};
+        glm::mat4 M = glm::translate(glm::mat4(1.0f), glm::vec3(s.centerX, 0.0f, 0.0f));
+        std::memcpy(inst.model, glm::value_ptr(M), sizeof(inst.model));
+        inst.lodFade = Lod_FadeIn(s.lod);
+        bool occluded = !s.occlusion.visible;
+        Indirect_AddRecord(glm::vec4(center, b.radius), b.lodCount[s.lod.level], b.lodFirst[s.lod.level], b.baseVertex, inst, occluded);
+        if (Lod_Fading(s.lod)) {
+            inst.lodFade = -inst.lodFade;
+            Indirect_AddRecord(glm::vec4(center, b.radius), b.lodCount[s.lod.previous], b.lodFirst[s.lod.previous], b.baseVertex, inst, occluded);
+        }
+        sectionGroup.nearest = std::min(sectionGroup.nearest, RenderQueue_Distance(center));
+    }
+    sectionGroup.recordCount = ind.records.size();
+    if (sectionGroup.recordCount > 0) ind.groups.push_back(sectionGroup);
+
+    for (const VariantFamily* f : { &g_carFamily, &g_jumpFamily, &g_slideFamily }) {
+        if (!f->VAO) continue;
+        IndirectGroup group;
+        group.VAO = f->VAO;
+        group.textures = &f->textures;
+        group.firstRecord = ind.records.size();
+        for (size_t v = 0; v < f->variants.size(); ++v) {
+            const VariantRange& range = f->variants[v];
+            if (range.indexCount == 0) continue;
+            const VariantBucket& bucket = f->pending[v];
+            for (size_t i = 0; i < bucket.visible.size(); ++i)
+                Indirect_AddRecord(bucket.visibleBounds[i], range.indexCount, range.firstIndex, range.baseVertex, bucket.visible[i], false);
+            for (size_t i = 0; i < bucket.occluded.size(); ++i)
+                Indirect_AddRecord(bucket.occludedBounds[i], range.indexCount, range.firstIndex, range.baseVertex, bucket.occluded[i], true);
+            group.nearest = std::min(group.nearest, f->nearest[v]);
+        }
+        group.recordCount = ind.records.size() - group.firstRecord;
+        if (group.recordCount > 0) ind.groups.push_back(group);
+    }
+    if (ind.records.empty()) return;
+
+    // instances aligned to their own size, so baseInstance indexes them from the range start
+    StreamRange instances = Stream_Upload(ind.instances.data(), ind.instances.size() * sizeof(VariantInstance), sizeof(VariantInstance));
+    for (const IndirectGroup& group : ind.groups) Indirect_AttachInstances(group.VAO, instances);
+    size_t recordBytes = ind.records.size() * sizeof(CullRecord);
+    StreamRange records = Stream_Upload(ind.records.data(), recordBytes, (size_t)std::max(ind.storageAlignment, 16));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, records.buffer, (GLintptr)records.offset, (GLsizeiptr)recordBytes);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ind.commandBuffer);
+    if (2 * ind.records.size() > ind.commandCapacity) {
+        ind.commandCapacity = 4 * ind.records.size();
+        glBufferData(GL_SHADER_STORAGE_BUFFER, ind.commandCapacity * sizeof(DrawCommand), nullptr, GL_DYNAMIC_COPY);
+    }
+
+    ShaderProgram& cull = *ind.cullShader;
+    cull.use();
+    cull.setInt("recordCount", (int)ind.records.size());
+    GLuint groups = (GLuint)((ind.records.size() + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE);
+    const glm::mat4* frusta[2] = { &viewProjection, &lightSpace };
+    for (int f = 0; f < 2; ++f) {
+        glm::vec4 planes[6];
+        extractFrustumPlanes(*frusta[f], planes);
+        glUniform4fv(cull.location("planes"), 6, glm::value_ptr(planes[0]));
+        cull.setInt("outputOffset", f * (int)ind.records.size());
+        cull.setInt("skipOccluded", f == 0 ? 1 : 0);
+        rrDispatchCompute(groups, 1, 1);
+    }
+    rrMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+// Queue one multi-draw per group (INSTANCED shader variants, or the instanced
+// depth shader for PASS_SHADOW)
+static void Indirect_Queue(ShaderProgram& shader, RenderPass pass)
+{
+    size_t passOffset = pass == PASS_SHADOW ? g_indirect.records.size() : 0;
+    for (const IndirectGroup& group : g_indirect.groups) {
+        DrawItem d;
+        d.kind = DrawKind::MultiIndirect;
+        d.program = &shader;
+        d.vao = group.VAO;
+        if (pass != PASS_SHADOW) {
+            d.textureArrays = group.textures;
+        }
+        d.key = RenderQueue_Key(pass, shader, pass != PASS_SHADOW ? group.textures->arrays[0] : 0, group.VAO, group.nearest);
+        d.count = (GLsizei)group.recordCount;
+        d.indirectBuffer = g_indirect.commandBuffer;
+        d.indirectOffset = (passOffset + group.firstRecord) * sizeof(DrawCommand);
+        RenderQueue_Submit(d);
+    }
+}
+
+// ===================== Shadow Cascades =====================
+// The directional light's shadow map is split into cascades along the view
+// frustum (practical split scheme up to g_shadowDistance), each rendered into a
+// layer of one depth texture array. A cascade's ortho box is fit around the
+// bounding sphere of its frustum slice, so its size never changes, and its
+// center is snapped to whole texels in light space, so the map doesn't shimmer
+// while the camera moves. Cascade c is re-rendered every
+// g_shadowCascadeInterval[c] frames (staggered); in between it keeps the matrix
+// it was rendered with and main.fs takes, per fragment, the first cascade that
+// covers it.
+static const int   MAX_SHADOW_CASCADES = 4;      // matches main.fs
+static const float SHADOW_SPLIT_LAMBDA = 0.75f;  // 0 = uniform splits, 1 = logarithmic
+static const float SHADOW_CASTER_MARGIN = 100.0f; // room for casters between the light and a cascade's box
+static int g_shadowCascadeInterval[MAX_SHADOW_CASCADES] = { 1, 1, 2, 4 };
+static float g_shadowDistance = 160.0f;          // no shadows past this view distance (Settings)
+
+struct ShadowCascade {
+    float     splitFar = 0.0f;             // view distance the cascade reaches
+    float     box[6] = {};                 // light-view ortho bounds: left right bottom top near far
+    glm::mat4 matrix = glm::mat4(1.0f);    // light projection * view it was last rendered with
+    bool      dirty = true;                // re-render next frame regardless of cadence
+    bool      due = false;                 // rendered this frame
+};
+
+struct ShadowCascades {
+    GLuint    FBO = 0, depthArray = 0;
+    GLsizei   size = 0;
+    int       count = 0;
+    glm::mat4 lightView = glm::mat4(1.0f); // rotation only, shared by all cascades
+    ShadowCascade cascades[MAX_SHADOW_CASCADES];
+    uint64_t  frame = 0;
+};
+
+static ShadowCascades g_shadows;
+
+// main thread: (re)create the depth array for `count` cascades of size x size
+static void Shadows_Init(GLsizei size, int count)
+{
+    ShadowCascades& sh = g_shadows;
+    sh.size = size;
+    sh.count = std::max(1, std::min(count, MAX_SHADOW_CASCADES));
+    if (!sh.depthArray) glGenTextures(1, &sh.depthArray);
+    if (!sh.FBO) glGenFramebuffers(1, &sh.FBO);
+    GLState_BindTexture(GL_TEXTURE_2D_ARRAY, sh.depthArray);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, size, size, sh.count, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE); // sampler2DArrayShadow
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+    for (ShadowCascade& c : sh.cascades) c.dirty = true;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, sh.FBO);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, sh.depthArray, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Shadow Framebuffer not complete!\n";
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// everything changed (reset): render all cascades next frame
+static void Shadows_Invalidate()
+{
+    for (ShadowCascade& c : g_shadows.cascades) c.dirty = true;
+}
+
+// origin rebase: the whole world moved by `offset`, so each cascade's cached map
+// is still right once its matrix (and light-space box) moves along with it
+static void Shadows_Translate(const glm::vec3& offset)
+{
+    ShadowCascades& sh = g_shadows;
+    glm::vec3 lo = glm::vec3(sh.lightView * glm::vec4(offset, 0.0f));
+    for (ShadowCascade& c : sh.cascades) {
+        c.matrix = c.matrix * glm::translate(glm::mat4(1.0f), -offset);
+        c.box[0] += lo.x; c.box[1] += lo.x;
+        c.box[2] += lo.y; c.box[3] += lo.y;
+        c.box[4] -= lo.z; c.box[5] -= lo.z; // near/far are distances along -z
+    }
+}
+
+// Once per frame, before the shadow pass: split the view frustum and refit the
+// cascades that are due this frame
+static void Shadows_Update(const Camera& cam, float aspect, float nearPlane, const glm::vec3& lightDir)
+{
+    ShadowCascades& sh = g_shadows;
+    glm::vec3 up = std::abs(lightDir.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    sh.lightView = glm::lookAt(glm::vec3(0.0f), lightDir, up);
+    float tanHalfY = std::tan(glm::radians(cam.Zoom) * 0.5f);
+    glm::vec3 right = glm::normalize(glm::cross(cam.Front, cam.WorldUp));
+    glm::vec3 camUp = glm::cross(right, cam.Front);
+
+    float splitNear = nearPlane;
+    for (int i = 0; i < sh.count; ++i) {
+        ShadowCascade& c = sh.cascades[i];
+        float t = (float)(i + 1) / sh.count;
+        float logSplit = nearPlane * std::pow(g_shadowDistance / nearPlane, t);
+        float uniformSplit = nearPlane + (g_shadowDistance - nearPlane) * t;
+        c.splitFar = glm::mix(uniformSplit, logSplit, SHADOW_SPLIT_LAMBDA);
+        int interval = std::max(1, g_shadowCascadeInterval[i]);
+        c.due = c.dirty || (sh.frame + i) % interval == 0;
+        float sliceNear = splitNear;
+        splitNear = c.splitFar;
+        if (!c.due) continue;
+
+        // bounding sphere of the slice; the radius only depends on the (fixed)
+        // projection, rounding keeps float noise from resizing the box
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int k = 0; k < 8; ++k) {
+            float d = (k & 4) ? c.splitFar : sliceNear;
+            float hy = d * tanHalfY, hx = hy * aspect;
+            corners[k] = cam.Position + cam.Front * d + right * ((k & 1) ? hx : -hx) + camUp * ((k & 2) ? hy : -hy);
+            center += corners[k] / 8.0f;
+        }
+        float radius = 0.0f;
+        for (const glm::vec3& p : corners) radius = std::max(radius, glm::length(p - center));
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        // snap the box center to the texel grid in light space
+        glm::vec3 lc = glm::vec3(sh.lightView * glm::vec4(center, 1.0f));
+        float texel = 2.0f * radius / (float)sh.size;
+        lc.x = std::floor(lc.x / texel) * texel;
+        lc.y = std::floor(lc.y / texel) * texel;
+        float box[6] = { lc.x - radius, lc.x + radius, lc.y - radius, lc.y + radius,
+                         -lc.z - radius - SHADOW_CASTER_MARGIN, -lc.z + radius };
+        std::memcpy(c.box, box, sizeof(box));
+        c.matrix = glm::ortho(box[0], box[1], box[2], box[3], box[4], box[5]) * sh.lightView;
+        c.dirty = false;
+    }
+    ++sh.frame;
+}
+
+// One light-space frustum around every cascade rendered this frame, for
+// culling shadow casters once for all of them
+static glm::mat4 Shadows_CullMatrix()
+{
+    const ShadowCascades& sh = g_shadows;
+    float box[6] = { std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+                     std::numeric_limits<float>::max(), -std::numeric_limits<float>::max(),
+                     std::numeric_limits<float>::max(), -std::numeric_limits<float>::max() };
+    bool any = false;
+    for (int i = 0; i < sh.count; ++i) {
+        const ShadowCascade& c = sh.cascades[i];
+        if (!c.due) continue;
+        for (int k = 0; k < 6; k += 2) {
+            box[k] = std::min(box[k], c.box[k]);
+            box[k + 1] = std::max(box[k + 1], c.box[k + 1]);
+        }
+        any = true;
+    }
+    if (!any) return glm::mat4(1.0f);
+    return glm::ortho(box[0], box[1], box[2], box[3], box[4], box[5]) * sh.lightView;
+}
+
+// Bind cascade `i`'s layer as the depth target, viewport included
+static void Shadows_BeginCascade(int i)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, g_shadows.FBO);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, g_shadows.depthArray, 0, i);
+    glViewport(0, 0, g_shadows.size, g_shadows.size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+// Cascade matrices for main.fs (the depth array goes on unit 1)
+static void Shadows_SetUniforms(ShaderProgram& shader)
+{
+    shader.setInt("cascadeCount", g_shadows.count);
+    for (int i = 0; i < g_shadows.count; ++i)
+        shader.setMat4("cascadeMatrices[" + std::to_string(i) + "]", g_shadows.cascades[i].matrix);
+}
+
+// ===================== Dynamic Resolution =====================
+// The 3D scene is drawn into an offscreen color/depth target at a fraction of
+// the window size, then stretched onto the window with a linear blit; the HUD
+// is drawn afterwards at native resolution. The fraction follows the GPU time
+// of the world (shadows + scene), read back from GL_TIME_ELAPSED queries a few
+// frames late so nothing stalls. Over budget it drops towards
+// scale * sqrt(target / measured) (cost follows the pixel count); under 85% of
+// it for a while it climbs back one DYNRES_STEP at a time. After each change it
+// waits for timings of the new size before moving again. With MSAA on, the
+// target is multisampled and resolved into a plain texture before the upscale.
+static const int   DYNRES_QUERIES = 4;       // timer queries in flight
+static const float DYNRES_MIN_SCALE = 0.5f;
+static const float DYNRES_MAX_SCALE = 1.0f;
+static const float DYNRES_STEP = 0.05f;      // scale changes snap to this
+static const int   DYNRES_SETTLE_FRAMES = 8; // after a change, before dropping again
+static const int   DYNRES_RAISE_FRAMES = 30; // under budget this long before going up
+static float g_dynResTargetMs = 12.0f;       // GPU budget for the world at 60 Hz, leaving room for the HUD
+static bool  g_dynResScaling = true;         // false = always full size (Settings)
+static int   g_dynResSamples = 0;            // MSAA samples of the scene target, <= 1 = off (Settings)
+
+struct DynamicResolution {
+    bool    enabled = true;
+    GLuint  FBO = 0, colorTexture = 0, depthBuffer = 0;
+    GLuint  resolveFBO = 0, colorBuffer = 0; // multisampled color + its resolve target, with MSAA
+    GLsizei width = 0, height = 0;           // allocated (full) size
+    int     samples = 0;
+    float   scale = DYNRES_MAX_SCALE;
+    float   gpuMs = 0.0f;                    // smoothed world time
+    GLuint  queries[DYNRES_QUERIES] = {};
+    bool    pending[DYNRES_QUERIES] = {};
+    int     next = 0;                        // query to start next
+    int     active = -1;                     // query timing this frame, -1 = none
+    int     framesSinceChange = 0;
+};
+
+static DynamicResolution g_dynRes;
+static int g_windowWidth = SCR_WIDTH, g_windowHeight = SCR_HEIGHT; // framebuffer size
+
+// (re)allocate the offscreen target at full window size when it changed
+static void DynRes_Resize(GLsizei width, GLsizei height, int samples)
+{
+    DynamicResolution& dr = g_dynRes;
+    if (samples > 1) {
+        GLint maxSamples = 0;
+        glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+        samples = std::min(samples, (int)maxSamples);
+    }
+    if (samples <= 1) samples = 0;
+    if (dr.FBO && dr.width == width && dr.height == height && dr.samples == samples) return;
+    if (!dr.FBO) {
+        glGenFramebuffers(1, &dr.FBO);
+        glGenFramebuffers(1, &dr.resolveFBO);
+        glGenTextures(1, &dr.colorTexture);
+        glGenRenderbuffers(1, &dr.colorBuffer);
+        glGenRenderbuffers(1, &dr.depthBuffer);
+        glGenQueries(DYNRES_QUERIES, dr.queries);
+    }
+    dr.width = width;
+    dr.height = height;
+    dr.samples = samples;
+    dr.enabled = true;
+    GLState_BindTexture(GL_TEXTURE_2D, dr.colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindFramebuffer(GL_FRAMEBUFFER, dr.resolveFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dr.colorTexture, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, dr.FBO);
+    if (samples) {
+        glBindRenderbuffer(GL_RENDERBUFFER, dr.colorBuffer);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, dr.colorBuffer);
+    }
+    else {
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, dr.colorTexture, 0);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, dr.depthBuffer);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, dr.depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Scene Framebuffer not complete, rendering at native resolution\n";
+        dr.enabled = false;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// Before the shadow pass: pick up finished timings, adjust the scale and
+// start timing this frame's world
+static void DynRes_BeginFrame()
+{
+    DynamicResolution& dr = g_dynRes;
+    DynRes_Resize(g_windowWidth, g_windowHeight, g_dynResSamples);
+    for (int i = 0; i < DYNRES_QUERIES; ++i) {
+        if (!dr.pending[i]) continue;
+        GLuint available = 0;
+        glGetQueryObjectuiv(dr.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) continue;
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(dr.queries[i], GL_QUERY_RESULT, &ns);
+        dr.pending[i] = false;
+        float ms = (float)(ns / 1.0e6);
+        dr.gpuMs = dr.gpuMs > 0.0f ? glm::mix(dr.gpuMs, ms, 0.2f) : ms;
+    }
+
+    ++dr.framesSinceChange;
+    if (dr.enabled && g_dynResScaling && dr.gpuMs > 0.0f) {
+        float scale = dr.scale;
+        float wanted = dr.scale * std::sqrt(g_dynResTargetMs / dr.gpuMs);
+        if (dr.gpuMs > g_dynResTargetMs && dr.framesSinceChange >= DYNRES_SETTLE_FRAMES)
+            scale -= std::max(DYNRES_STEP, std::floor((dr.scale - wanted) / DYNRES_STEP) * DYNRES_STEP);
+        else if (dr.gpuMs < g_dynResTargetMs * 0.85f && dr.framesSinceChange >= DYNRES_RAISE_FRAMES &&
+                 wanted >= dr.scale + DYNRES_STEP)
+            scale += DYNRES_STEP;
+        scale = glm::clamp(scale, DYNRES_MIN_SCALE, DYNRES_MAX_SCALE);
+        if (scale != dr.scale) {
+            dr.scale = scale;
+            dr.framesSinceChange = 0;
+        }
+    }
+    if (!dr.enabled || !g_dynResScaling) dr.scale = 1.0f;
+    g_frameStats.gpuMs = dr.gpuMs;
+    g_frameStats.renderScale = dr.scale;
+
+    // if the GPU is DYNRES_QUERIES frames behind, this frame goes untimed
+    dr.active = -1;
+    if (!dr.pending[dr.next]) {
+        glBeginQuery(GL_TIME_ELAPSED, dr.queries[dr.next]);
+        dr.pending[dr.next] = true;
+        dr.active = dr.next;
+        dr.next = (dr.next + 1) % DYNRES_QUERIES;
+    }
+}
+
+// render size of the scene this frame
+static GLsizei DynRes_Width() { return std::max<GLsizei>(1, (GLsizei)(g_dynRes.width * g_dynRes.scale)); }
+static GLsizei DynRes_Height() { return std::max<GLsizei>(1, (GLsizei)(g_dynRes.height * g_dynRes.scale)); }
+
+// After the shadow pass: bind the scene target and its scaled viewport
+static void DynRes_BindScene()
+{
+    if (g_dynRes.enabled) {
+        glBindFramebuffer(GL_FRAMEBUFFER, g_dynRes.FBO);
+        glViewport(0, 0, DynRes_Width(), DynRes_Height());
+    }
+    else {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, g_windowWidth, g_windowHeight);
+    }
+}
+
+// After the scene: stop timing, upscale onto the window and leave it bound
+// at native resolution for the HUD
+static void DynRes_Resolve()
+{
+    DynamicResolution& dr = g_dynRes;
+    if (dr.active >= 0) glEndQuery(GL_TIME_ELAPSED);
+    dr.active = -1;
+    if (dr.enabled) {
+        // multisampled blits can't scale: resolve at render size first
+        GLuint source = dr.FBO;
+        if (dr.samples) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, dr.FBO);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, dr.resolveFBO);
+            glBlitFramebuffer(0, 0, DynRes_Width(), DynRes_Height(), 0, 0, DynRes_Width(), DynRes_Height(),
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            source = dr.resolveFBO;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, source);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        glBlitFramebuffer(0, 0, DynRes_Width(), DynRes_Height(), 0, 0, g_windowWidth, g_windowHeight,
+                          GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, g_windowWidth, g_windowHeight);
+}
+
+// ===================== Settings =====================
+// Graphics and gameplay settings that differ per machine. A quality preset
+// fills in the defaults, then RoadRunner.cfg (`key = value` lines, # starts a
+// comment) and `--key=value` arguments override single values, in that order.
+// The file is re-read when it changes on disk and F4 steps through the
+// presets, both while the game runs.
+enum class QualityPreset { Low, Medium, High, Ultra };
+static const char* QUALITY_PRESET_NAMES[] = { "low", "medium", "high", "ultra" };
+static const int QUALITY_PRESET_COUNT = 4;
+static const char* SETTINGS_FILE = "RoadRunner.cfg";
+static const double SETTINGS_POLL_INTERVAL = 1.0; // seconds between checks of the file
+
+struct Settings {
+    QualityPreset preset = QualityPreset::High;
+    int   windowWidth = SCR_WIDTH, windowHeight = SCR_HEIGHT;
+    bool  vsync = true;
+    int   fpsCap = 0;                 // 0 = uncapped
+    int   shadowSize = 2048;          // per cascade, square
+    int   shadowCascades = 3;
+    float shadowDistance = 160.0f;
+    float lodBias = 1.0f;
+    float viewDistance = 500.0f;      // far plane and streaming distance
+    int   msaaSamples = 0;
+    bool  dynamicResolution = true;
+    float gpuTargetMs = 12.0f;
+    float probCar = 0.25f, probJump = 0.20f, probSlide = 0.20f, probWires = 0.08f;
+};
+
+static Settings g_settings;
+static std::vector<std::pair<std::string, std::string>> g_settingsArgs; // command-line overrides
+static int g_presetOverride = -1;                                       // F4, beats the file and arguments
+static std::filesystem::file_time_type g_settingsFileTime;
+static double g_settingsNextPoll = 0.0;
+
+// the values each preset scales; everything else keeps its default
+static void Settings_ApplyPreset(Settings& s, QualityPreset preset)
+{
+    static const struct {
+        int shadowSize, shadowCascades; float shadowDistance, lodBias, viewDistance; int msaaSamples;
+    } presets[QUALITY_PRESET_COUNT] = {
+        { 1024, 2, 100.0f, 2.0f,  300.0f, 0 }, // Low
+        { 2048, 2, 130.0f, 1.5f,  400.0f, 0 }, // Medium
+        { 2048, 3, 160.0f, 1.0f,  500.0f, 2 }, // High
+        { 4096, 4, 220.0f, 0.75f, 650.0f, 4 }, // Ultra
+    };
+    const auto& p = presets[(int)preset];
+    s.preset = preset;
+    s.shadowSize = p.shadowSize;
+    s.shadowCascades = p.shadowCascades;
+    s.shadowDistance = p.shadowDistance;
+    s.lodBias = p.lodBias;
+    s.viewDistance = p.viewDistance;
+    s.msaaSamples = p.msaaSamples;
+}
+
+static bool parsePreset(const std::string& value, QualityPreset& out)
+{
+    for (int i = 0; i < QUALITY_PRESET_COUNT; ++i) {
+        if (value == QUALITY_PRESET_NAMES[i]) { out = (QualityPreset)i; return true; }
+    }
+    return false;
+}
+
+// one `key = value`; false for unknown keys and unparsable values
+static bool Settings_Set(Settings& s, const std::string& key, const std::string& value)
+{
+    auto toInt = [&](int& out, int lo, int hi) {
+        char* end = nullptr;
+        long v = std::strtol(value.c_str(), &end, 10);
+        if (end == value.c_str() || *end) return false;
+        out = (int)std::max<long>(lo, std::min<long>(hi, v));
+        return true;
+        };
+    auto toFloat = [&](float& out, float lo, float hi) {
+        char* end = nullptr;
+        float v = std::strtof(value.c_str(), &end);
+        if (end == value.c_str() || *end) return false;
+        out = glm::clamp(v, lo, hi);
+        return true;
+        };
+    auto toBool = [&](bool& out) {
+        if (value == "1" || value == "true" || value == "on") { out = true; return true; }
+        if (value == "0" || value == "false" || value == "off") { out = false; return true; }
+        return false;
+        };
+
+    if (key == "preset") {
+        QualityPreset preset;
+        if (!parsePreset(value, preset)) return false;
+        Settings_ApplyPreset(s, preset);
+        return true;
+    }
+    if (key == "width") return toInt(s.windowWidth, 320, 7680);
+    if (key == "height") return toInt(s.windowHeight, 240, 4320);
+    if (key == "vsync") return toBool(s.vsync);
+    if (key == "fps_cap") return toInt(s.fpsCap, 0, 1000);
+    if (key == "shadow_size") return toInt(s.shadowSize, 256, 8192);
+    if (key == "shadow_cascades") return toInt(s.shadowCascades, 1, MAX_SHADOW_CASCADES);
+    if (key == "shadow_distance") return toFloat(s.shadowDistance, 20.0f, 1000.0f);
+    if (key == "lod_bias") return toFloat(s.lodBias, 0.25f, 8.0f);
+    if (key == "view_distance") return toFloat(s.viewDistance, 100.0f, 2000.0f);
+    if (key == "msaa") return toInt(s.msaaSamples, 0, 16);
+    if (key == "dynamic_resolution") return toBool(s.dynamicResolution);
+    if (key == "gpu_target_ms") return toFloat(s.gpuTargetMs, 2.0f, 100.0f);
+    if (key == "prob_car") return toFloat(s.probCar, 0.0f, 1.0f);
+    if (key == "prob_jump") return toFloat(s.probJump, 0.0f, 1.0f);
+    if (key == "prob_slide") return toFloat(s.probSlide, 0.0f, 1.0f);
+    if (key == "prob_wires") return toFloat(s.probWires, 0.0f, 1.0f);
+    return false;
+}
+
+static std::string trimmed(const std::string& text)
+{
+    size_t first = text.find_first_not_of(" \t\r");
+    if (first == std::string::npos) return "";
+    size_t last = text.find_last_not_of(" \t\r");
+    return text.substr(first, last - first + 1);
+}
+
+// Defaults, file, arguments, F4 preset. A `preset` line resets what the preset
+// covers, so the preset is applied before every other key regardless of order.
+static Settings Settings_Load()
+{
+    std::vector<std::pair<std::string, std::string>> values;
+    std::string path = FileSystem::getPath(SETTINGS_FILE);
+    std::ifstream in(path);
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); ++lineNumber) {
+        line = trimmed(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) {
+            std::cerr << SETTINGS_FILE << ":" << lineNumber << ": expected key = value\n";
+            continue;
+        }
+        values.emplace_back(trimmed(line.substr(0, eq)), trimmed(line.substr(eq + 1)));
+    }
+    values.insert(values.end(), g_settingsArgs.begin(), g_settingsArgs.end());
+    if (g_presetOverride >= 0) values.emplace_back("preset", QUALITY_PRESET_NAMES[g_presetOverride]);
+
+    Settings s;
+    for (const auto& kv : values) {
+        if (kv.first == "preset" && !Settings_Set(s, kv.first, kv.second))
+            std::cerr << "Unknown quality preset '" << kv.second << "'\n";
+    }
+    for (const auto& kv : values) {
+        if (kv.first != "preset" && !Settings_Set(s, kv.first, kv.second))
+            std::cerr << "Ignoring setting " << kv.first << " = " << kv.second << "\n";
+    }
+
+    std::error_code ec;
+    g_settingsFileTime = std::filesystem::last_write_time(path, ec);
+    return s;
+}
+
+// Push settings into the systems that read them. Cheap values are copied every
+// time; the shadow array, scene target and window only change when they differ.
+static void Settings_Apply(GLFWwindow* window, const Settings& s)
+{
+    g_settings = s;
+    g_farPlane = s.viewDistance;
+    g_lodBias = s.lodBias;
+    g_shadowDistance = s.shadowDistance;
+    g_dynResScaling = s.dynamicResolution;
+    g_dynResTargetMs = s.gpuTargetMs;
+    g_dynResSamples = s.msaaSamples;  // DynRes_Resize picks it up next frame
+    PROB_CAR = s.probCar;
+    PROB_JUMP = s.probJump;
+    PROB_SLIDE = s.probSlide;
+    PROB_WIRES = s.probWires;
+    if (g_shadows.size != s.shadowSize || g_shadows.count != s.shadowCascades) Shadows_Init(s.shadowSize, s.shadowCascades);
+    glfwSwapInterval(s.vsync ? 1 : 0);
+
+    int width = 0, height = 0;
+    glfwGetWindowSize(window, &width, &height);
+    if (width != s.windowWidth || height != s.windowHeight) glfwSetWindowSize(window, s.windowWidth, s.windowHeight);
+}
+
+// Once per frame: re-read the file when it changed
+static void Settings_Poll(GLFWwindow* window)
+{
+    double now = glfwGetTime();
+    if (now < g_settingsNextPoll) return;
+    g_settingsNextPoll = now + SETTINGS_POLL_INTERVAL;
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(FileSystem::getPath(SETTINGS_FILE), ec);
+    if (ec || time == g_settingsFileTime) return;
+    std::cout << "Reloading " << SETTINGS_FILE << "\n";
+    Settings_Apply(window, Settings_Load());
+}
+
+// F4: next preset, on top of the file and arguments
+static void Settings_CyclePreset(GLFWwindow* window)
+{
+    g_presetOverride = ((int)g_settings.preset + 1) % QUALITY_PRESET_COUNT;
+    Settings_Apply(window, Settings_Load());
+    std::cout << "Quality preset: " << QUALITY_PRESET_NAMES[g_presetOverride] << "\n";
+}
+
+// ===================== Input Events =====================
+// Key presses and releases arrive through key_callback while GLFW waits for or
+// polls events (Pacing_EndFrame, including the frame cap wait), stamped with
+// glfwGetTime, and processInput consumes them in order at the top of the next
+// frame. A tap shorter than a frame still counts, and keys hit within one frame
+// apply in the order they were hit. An action a press starts (jump, slide, lane
+// change) is advanced by the press's age at frame time, so it runs from when the
+// key went down rather than from the frame that noticed it. Held keys (debug
+// camera movement) still read glfwGetKey.
+//
+// Input latency: a press that moves the player (jump, slide, lane change)
+// marks the frame it took effect in; once that frame's swap returns, the time
+// since the press is recorded. F3 shows the average and worst of the last
+// INPUT_LATENCY_SAMPLES.
+struct InputEvent {
+    int    key;
+    bool   pressed;   // false = released
+    double time;      // glfwGetTime when GLFW delivered it
+};
+
+static std::vector<InputEvent> g_inputEvents; // main thread only: callbacks run inside glfwPoll/WaitEvents
+
+static void key_callback(GLFWwindow*, int key, int, int action, int)
+{
+    if (action == GLFW_REPEAT || key == GLFW_KEY_UNKNOWN) return;
+    g_inputEvents.push_back({ key, action == GLFW_PRESS, glfwGetTime() });
+}
+
+// seconds between a press and this frame's time (lastFrame)
+static float Input_Age(const InputEvent& e)
+{
+    return std::max(0.0f, (float)((double)lastFrame - e.time));
+}
+
+static const int INPUT_LATENCY_SAMPLES = 32;
+
+struct InputLatency {
+    double pressTime = -1.0;  // earliest press whose reaction isn't presented yet
+    float  samples[INPUT_LATENCY_SAMPLES] = {};  // ms, ring
+    int    count = 0, next = 0;
+};
+
+static InputLatency g_inputLatency;
+
+// the frame being built shows the reaction to a press at `time`
+static void Input_MarkReaction(double time)
+{
+    if (g_inputLatency.pressTime < 0.0 || time < g_inputLatency.pressTime) g_inputLatency.pressTime = time;
+}
+
+// right after every swap
+static void Input_FramePresented(double now)
+{
+    InputLatency& l = g_inputLatency;
+    if (l.pressTime >= 0.0) {
+        l.samples[l.next] = (float)((now - l.pressTime) * 1000.0);
+        l.next = (l.next + 1) % INPUT_LATENCY_SAMPLES;
+        l.count = std::min(l.count + 1, INPUT_LATENCY_SAMPLES);
+        l.pressTime = -1.0;
+    }
+    float sum = 0.0f, worst = 0.0f;
+    for (int i = 0; i < l.count; ++i) {
+        sum += l.samples[i];
+        worst = std::max(worst, l.samples[i]);
+    }
+    g_frameStats.inputMs = l.count ? sum / l.count : 0.0f;
+    g_frameStats.inputWorstMs = worst;
+}
+
+// ===================== Frame Pacing =====================
+// End of every frame: present, then wait. In game the wait is the optional
+// frame cap (Settings fps_cap), on top of vsync when that's on: GLFW waits for
+// events until the deadline, so input arriving during the cap is delivered (and
+// stamped) as it comes instead of after the wait. The start and game-over
+// screens are static, so they block in the event queue instead and only redraw
+// on input or every PACING_MENU_IDLE seconds; a burst of input is held to
+// PACING_MENU_MAX_FPS by sleeping off the rest of the frame, never spinning.
+static const double PACING_MENU_MAX_FPS = 30.0;
+static const double PACING_MENU_IDLE = 0.5;
+
+struct FramePacing {
+    double deadline = 0.0;     // when the next capped frame may start
+};
+
+static FramePacing g_pacing;
+
+// handle events until `deadline` (glfwGetTime seconds)
+static void Pacing_WaitUntil(double deadline)
+{
+    double start = glfwGetTime();
+    glfwPollEvents();
+    for (double now = glfwGetTime(); now < deadline; now = glfwGetTime())
+        glfwWaitEventsTimeout(deadline - now);
+    g_frameStats.waitMs += (float)((glfwGetTime() - start) * 1000.0);
+}
+
+// replaces glfwSwapBuffers + glfwPollEvents; `menu` for the static screens
+static void Pacing_EndFrame(GLFWwindow* window, bool menu)
+{
+    FramePacing& p = g_pacing;
+    glfwSwapBuffers(window);
+    double now = glfwGetTime();
+    Input_FramePresented(now);
+
+    if (menu) {
+        glfwWaitEventsTimeout(PACING_MENU_IDLE);
+        double rest = 1.0 / PACING_MENU_MAX_FPS - (glfwGetTime() - now);
+        if (rest > 0.0) {
+            std::this_thread::sleep_for(std::chrono::duration<double>(rest));
+            glfwPollEvents(); // whatever came in while asleep
+        }
+        p.deadline = 0.0;
+        lastFrame = (float)glfwGetTime(); // time spent idle isn't simulated
+        return;
+    }
+
+    if (g_settings.fpsCap > 0) {
+        double interval = 1.0 / g_settings.fpsCap;
+        // fixed cadence; after a long frame start over instead of catching up
+        p.deadline = (p.deadline > 0.0 && now - p.deadline < interval) ? p.deadline + interval : now + interval;
+        Pacing_WaitUntil(p.deadline);
+        return;
+    }
+    p.deadline = 0.0;
+    glfwPollEvents();
+}
+
+// ===================== Generation =====================
+// before a section is dropped: its batch slot and occlusion queries go back to their pools
+static void releaseSection(Section& s)
+{
+    Batches_Release(s);
+    Occlusion_Release(s.occlusion);
+    for (Obstacle& o : s.laneObstacles) Occlusion_Release(o.occlusion);
+}
+
+static uint32_t g_nextObstacleId = 0;
+
+// Sections past the current ones come from worker jobs: each generates a section
+// around x = 0 and merges its batch, then queues a step that places it behind
+// the last section (so an origin rebase in between doesn't matter). Generation
+// holds g_streamMutex, which guards rng and g_nextObstacleId.
+static std::mutex g_streamMutex;
+static int g_streamPending = 0;   // main thread: requested sections not added yet
+static int g_streamEpoch = 0;     // main thread: bumped when the sections restart, dropping stale steps
+
+struct GeneratedSection {
+    Section section;
+    SectionGeometry geometry;
+};
 
-// ===================== Generation =====================
+// caller holds g_streamMutex
 static Section generateSection(float centerX)
 {
     Section s;
@@ -558,6 +5222,7 @@ static Section generateSection(float centerX)
         float xOffset = (uni01(rng) - 0.1f) * (SECTION_LENGTH * 0.45f);
         obs.pos.x = centerX + xOffset;
         obs.variantIndex = -1;
+        obs.id = ++g_nextObstacleId;
 
         if (r < PROB_CAR) {
             obs.type = ObstacleType::Car;
@@ -594,12 +5259,44 @@ static Section generateSection(float centerX)
     return s;
 }
 
-static void generateSectionsUpTo(float playerX)
+// any thread: a new section around x = 0 with its merged batch
+static std::shared_ptr<GeneratedSection> buildSection()
+{
+    auto g = std::make_shared<GeneratedSection>();
+    {
+        std::lock_guard<std::mutex> lock(g_streamMutex);
+        g->section = generateSection(0.0f);
+    }
+    Batches_MergeSection(g->section, g->geometry);
+    return g;
+}
+
+// main thread: move a generated section to `centerX`, upload its batch and append it
+static void addSection(GeneratedSection& g, float centerX)
+{
+    Section& s = g.section;
+    s.centerX = centerX;
+    for (Obstacle& o : s.laneObstacles) o.pos.x += centerX;
+    Batches_UploadSection(s, g.geometry);
+    sections.push_back(std::move(s));
+}
+
+// `speed` is the current forward speed (units/sec)
+static void generateSectionsUpTo(float playerX, float speed)
 {
+    float visibleEdge = playerX + g_farPlane - CAM_DISTANCE;
+    float readyEdge = visibleEdge + std::max(speed, 0.0f) * STREAM_LEAD_SECONDS;
+    auto frontier = [&]() { return sections.back().centerX + SECTION_LENGTH * 0.5f; };
+
     if (sections.empty()) {
-        // align the first generated section so the player is inside it
+        // (re)start: jobs still in flight belong to the old run
+        ++g_streamEpoch;
+        g_streamPending = 0;
+
+        // align the first generated section so the player is inside it; the
+        // initial window is built right here, before the run starts
         float startCenterX = std::floor(playerX / SECTION_LENGTH) * SECTION_LENGTH + SECTION_LENGTH * 0.5f;
-        sections.push_back(generateSection(startCenterX));
+        addSection(*buildSection(), startCenterX);
 
         // ensure first section has no obstacles (for safe spawn / debugging)
         Section& first = sections.front();
@@ -612,9 +5309,7 @@ static void generateSectionsUpTo(float playerX)
             first.laneObstacles[i].pos.z = laneZ(i);
         }
 
-        for (int i = 1; i <= SECTIONS_AHEAD; ++i) {
-            sections.push_back(generateSection(startCenterX + i * SECTION_LENGTH));
-        }
+        while (frontier() < readyEdge) addSection(*buildSection(), sections.back().centerX + SECTION_LENGTH);
         currentSectionIndex = 0;
         return;
     }
@@ -628,20 +5323,27 @@ static void generateSectionsUpTo(float playerX)
     if (playerSection == -1) playerSection = 0;
     currentSectionIndex = playerSection;
 
-    // Ensure we keep existing sections intact and only append the needed sections at the back.
-    // Desired size = index of current section + SECTIONS_AHEAD + 1 (current + ahead)
-    int desiredSize = currentSectionIndex + SECTIONS_AHEAD + 1;
-    // Append new sections until we reach desired size; do not regenerate existing sections.
-    while ((int)sections.size() < desiredSize) {
-        float lastCenterX = sections.back().centerX;
-        float newX = lastCenterX + SECTION_LENGTH;
-        sections.push_back(generateSection(newX));
+    // Append new sections at the back (existing sections are never regenerated):
+    // add finished ones, then request whatever the lead still lacks
+    Loader_DrainUploads(UPLOAD_BUDGET_SECONDS, STREAM_SECTIONS_PER_FRAME);
+    while (frontier() + g_streamPending * SECTION_LENGTH < readyEdge) {
+        ++g_streamPending;
+        int epoch = g_streamEpoch;
+        Jobs_Submit([epoch]() {
+            auto g = buildSection();
+            Loader_QueueUploads({ [g, epoch]() {
+                if (epoch != g_streamEpoch) return;
+                --g_streamPending;
+                addSection(*g, sections.back().centerX + SECTION_LENGTH);
+            } });
+        });
     }
 
-    // Remove old sections at front if player moved far ahead
-    while (sections.size() > 0) {
+    // Remove old sections at front once they're behind the camera
+    while (sections.size() > 1) {
         float firstCenter = sections.front().centerX;
-        if (playerX > firstCenter + SECTION_LENGTH * 3.5f) {
+        if (playerX > firstCenter + SECTION_LENGTH * 0.5f + STREAM_TRAIL_DISTANCE) {
+            releaseSection(sections.front());
             sections.erase(sections.begin());
             if (currentSectionIndex > 0) --currentSectionIndex;
         }
@@ -649,6 +5351,53 @@ static void generateSectionsUpTo(float playerX)
     }
 }
 
+// Floating origin: once the player is REBASE_DISTANCE down the road, everything
+// is shifted back by a whole number of sections so positions (and the camera
+// lerp) keep full float precision. Section batches are section-local and
+// obstacle instances are rebuilt every frame, so the GPU side only sees the new
+// centerX through the model uniform; cached shadow cascades are moved along.
+// Sections still being generated are placed relative to the last one, so they
+// need nothing.
+static const float REBASE_DISTANCE = 4096.0f;
+
+static void rebaseWorldOrigin()
+{
+    if (player.pos.x < REBASE_DISTANCE) return;
+    float shift = std::floor(player.pos.x / SECTION_LENGTH) * SECTION_LENGTH;
+    player.pos.x -= shift;
+    player.lastScoreUpdateX -= shift;
+    for (auto& s : sections) {
+        s.centerX -= shift;
+        for (Obstacle& o : s.laneObstacles) o.pos.x -= shift;
+    }
+    camera.Position.x -= shift;
+    cameraTargetPos.x -= shift;
+    Shadows_Translate(glm::vec3(-shift, 0.0f, 0.0f));
+}
+
+// ===================== Traffic Audio =====================
+// Once per frame: the cars within earshot, relative to the camera (so an
+// origin rebase doesn't move them), go to the audio thread, which decides which
+// of them actually play. Outside a run the list is empty, silencing them all.
+static void Audio_PostTraffic(const Camera& cam, bool playing)
+{
+    if (!g_audioThread.joinable()) return;
+    TrafficSnapshot& snap = g_trafficSnapshots[g_trafficBack];
+    snap.front[0] = cam.Front.x; snap.front[1] = cam.Front.y; snap.front[2] = cam.Front.z;
+    snap.count = 0;
+    if (playing) {
+        for (const Section& s : sections) {
+            if (std::abs(s.centerX - cam.Position.x) > AUDIO_TRAFFIC_RANGE + SECTION_LENGTH) continue;
+            for (const Obstacle& o : s.laneObstacles) {
+                if (o.type != ObstacleType::Car || snap.count == AUDIO_TRAFFIC_SOURCES) continue;
+                glm::vec3 rel = o.pos - cam.Position;
+                if (glm::length(rel) < AUDIO_TRAFFIC_RANGE) snap.cars[snap.count++] = { o.id, { rel.x, rel.y, rel.z } };
+            }
+        }
+    }
+    g_trafficBack = g_trafficLatest.exchange(g_trafficBack | AUDIO_SNAPSHOT_NEW, std::memory_order_acq_rel) & 3;
+}
+
 // ===================== Collision & Game Reset =====================
 
 // Helper: decide if player state allows passing a given obstacle
@@ -719,8 +5468,10 @@ static void restartGameFromGameOver()
     player.laneSwitchTimer = 0.0f;
     player.score = 0;
     player.lastScoreUpdateX = playerSpawnPos.x;
+    for (auto& s : sections) releaseSection(s);
     sections.clear();
-    generateSectionsUpTo(player.pos.x);
+    generateSectionsUpTo(player.pos.x, PLAYER_FORWARD_SPEED);
+    Shadows_Invalidate();
     currentGameState = GameState::PLAYING;
     Audio_PlayRunningLoop();
 }
@@ -741,49 +5492,53 @@ static void updateDebugCameraVectors(Camera& cam)
     cam.Pitch = debugPitch;
 }
 
-// Add these static variables near the top with other input state
-static bool jumpKeyPressed = false;
-static bool slideKeyPressed = false;
-static bool leftKeyPressed = false;
-static bool rightKeyPressed = false;
+// A lane key hit during the lane-change cooldown waits for it while held
+static int g_pendingLaneKey = GLFW_KEY_UNKNOWN;
+static double g_pendingLaneTime = 0.0;
 
-static void processInput(GLFWwindow* window)
+// `age`: how far into the change this frame already is (see Input Events)
+static void changeLane(int direction, double pressTime, float age)
+{
+    int newLane = player.laneIndex + direction;
+    if (newLane < 0 || newLane >= LANE_COUNT) return;
+    float targetZ = laneZ(newLane);
+    bool wasSidestepping = player.isSidestepping;
+    player.startSidestep(direction, player.pos.z, targetZ);  // Pass current and target Z
+    if (!wasSidestepping && player.isSidestepping) player.sidestepTimer = std::min(age, Player::sidestepDuration);
+    player.laneIndex = newLane;
+    player.laneSwitchTimer = std::max(0.0f, LANE_SWITCH_COOLDOWN - age);
+    Input_MarkReaction(pressTime);
+}
+
+// One key press, in the order they happened
+static void handleKeyPress(GLFWwindow* window, const InputEvent& e)
 {
-    if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) glfwSetWindowShouldClose(window, true);
+    if (e.key == GLFW_KEY_ESCAPE) { glfwSetWindowShouldClose(window, true); return; }
 
     // Handle start screen
     if (currentGameState == GameState::START_SCREEN) {
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && !startKeyPressed) {
-            startKeyPressed = true;
+        if (e.key == GLFW_KEY_SPACE) {
             currentGameState = GameState::PLAYING;
             std::cout << "Game Started!\n";
             Audio_PlayClick();
             Audio_PlayRunningLoop();
         }
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_RELEASE) {
-            startKeyPressed = false;
-        }
         return; // Don't process other inputs on start screen
     }
 
     // Handle game over screen
     if (currentGameState == GameState::GAME_OVER) {
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS && !startKeyPressed) {
-            startKeyPressed = true;
+        if (e.key == GLFW_KEY_SPACE) {
             restartGameFromGameOver();
             std::cout << "Game Restarted!\n";
             Audio_PlayClick();
             Audio_PlayRunningLoop();
         }
-        if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_RELEASE) {
-            startKeyPressed = false;
-        }
         return; // Don't process other inputs on game over screen
     }
 
-    // Toggle debug camera with F1 (debounced)
-    if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS && !debugTogglePressed) {
-        debugTogglePressed = true;
+    switch (e.key) {
+    case GLFW_KEY_F1: // Toggle debug camera
         debugCameraEnabled = !debugCameraEnabled;
         firstMouse = true;
         if (debugCameraEnabled) {
@@ -799,10 +5554,67 @@ static void processInput(GLFWwindow* window)
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
             debugMouseCapture = false;
         }
+        return;
+    case GLFW_KEY_F3: // Toggle the profiler overlay
+        g_profilerOverlay = !g_profilerOverlay;
+        return;
+    case GLFW_KEY_F4: // Next quality preset
+        Settings_CyclePreset(window);
+        return;
+    }
+    if (debugCameraEnabled) return; // don't process gameplay input while debugging
+
+    // Gameplay input (lane switching, jump, slide)
+    switch (e.key) {
+    case GLFW_KEY_A:
+    case GLFW_KEY_D:
+        if (player.laneSwitchTimer > 0.0f) {
+            g_pendingLaneKey = e.key;
+            g_pendingLaneTime = e.time;
+        }
+        else {
+            changeLane(e.key == GLFW_KEY_A ? -1 : 1, e.time, Input_Age(e));
+        }
+        break;
+    case GLFW_KEY_W: {
+        bool wasJumping = player.isJumping;
+        player.startJump();
+        if (!wasJumping && player.isJumping) {
+            player.jumpTimer = std::min(Input_Age(e), Player::jumpDuration);
+            Input_MarkReaction(e.time);
+        }
+        std::cout << "Jump key pressed!\n"; // Debug
+        Audio_PlayJump();
+        break;
+    }
+    case GLFW_KEY_S: {
+        // one press = fixed duration animation
+        bool wasSliding = player.isSliding;
+        player.startSlide();
+        if (!wasSliding && player.isSliding) {
+            player.slideTimer = std::min(Input_Age(e), Player::slideDuration);
+            Input_MarkReaction(e.time);
+        }
+        std::cout << "Slide key pressed!\n"; // Debug
+        Audio_PlaySlideLoop();
+        break;
+    }
+    }
+}
+
+static void processInput(GLFWwindow* window)
+{
+    // Presses since the last frame, oldest first (see Input Events); indexed
+    // in case a handler pumps events (e.g. resizing the window for a preset)
+    for (size_t i = 0; i < g_inputEvents.size(); ++i) {
+        InputEvent e = g_inputEvents[i];
+        if (e.pressed) handleKeyPress(window, e);
     }
-    if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_RELEASE) debugTogglePressed = false;
+    g_inputEvents.clear();
+    if (currentGameState != GameState::PLAYING) return;
 
     if (debugCameraEnabled) {
+        g_pendingLaneKey = GLFW_KEY_UNKNOWN;
         float moveSpeed = DEBUG_CAM_SPEED * deltaTime;
         float turnSpeed = DEBUG_CAM_TURN_SPEED * deltaTime;
         if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) camera.Position += camera.Front * moveSpeed;
@@ -818,72 +5630,33 @@ static void processInput(GLFWwindow* window)
         if (debugPitch > 89.0f) debugPitch = 89.0f;
         if (debugPitch < -89.0f) debugPitch = -89.0f;
         updateDebugCameraVectors(camera);
-        return; // don't process gameplay input while debugging
-    }
-
-    // Gameplay input (lane switching, jump, slide, crouch)
-    if (player.laneSwitchTimer <= 0.0f) {
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-            if (!leftKeyPressed && player.laneIndex > 0) {
-                int newLane = player.laneIndex - 1;
-                float targetZ = laneZ(newLane);
-                player.startSidestep(-1, player.pos.z, targetZ);  // Pass current and target Z
-                player.laneIndex = newLane;
-                player.laneSwitchTimer = LANE_SWITCH_COOLDOWN;
-                leftKeyPressed = true;
-            }
-        }
-        else {
-            leftKeyPressed = false;
-        }
-
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-            if (!rightKeyPressed && player.laneIndex < LANE_COUNT - 1) {
-                int newLane = player.laneIndex + 1;
-                float targetZ = laneZ(newLane);
-                player.startSidestep(1, player.pos.z, targetZ);  // Pass current and target Z
-                player.laneIndex = newLane;
-                player.laneSwitchTimer = LANE_SWITCH_COOLDOWN;
-                rightKeyPressed = true;
-            }
-        }
-        else {
-            rightKeyPressed = false;
-        }
+        return;
     }
 
-    // Jump (edge-triggered: only trigger on key DOWN, not while held)
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        if (!jumpKeyPressed) {
-            player.startJump();
-            jumpKeyPressed = true;
-            std::cout << "Jump key pressed!\n"; // Debug
-            Audio_PlayJump();
+    // lane key from the cooldown: change once it's over, if still held
+    if (g_pendingLaneKey != GLFW_KEY_UNKNOWN) {
+        if (glfwGetKey(window, g_pendingLaneKey) != GLFW_PRESS) {
+            g_pendingLaneKey = GLFW_KEY_UNKNOWN;
         }
-    }
-    else {
-        jumpKeyPressed = false;
-    }
-
-    // REVERTED: Slide is now edge-triggered again (one press = fixed duration animation)
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        if (!slideKeyPressed) {
-            player.startSlide();
-            slideKeyPressed = true;
-            std::cout << "Slide key pressed!\n"; // Debug
-            Audio_PlaySlideLoop();
+        else if (player.laneSwitchTimer <= 0.0f) {
+            changeLane(g_pendingLaneKey == GLFW_KEY_A ? -1 : 1, g_pendingLaneTime, 0.0f); // starts now, as the cooldown ends
+            g_pendingLaneKey = GLFW_KEY_UNKNOWN;
         }
     }
-    else {
-        slideKeyPressed = false;
-    }
 }
 
 // Mouse callback for debug mouse-look
 // Mouse callback for debug mouse-look
 static void mouse_callback(GLFWwindow* window, double xpos, double ypos)
 {
-    // Store mouse position for UI interactions
+    // Store mouse position for UI interactions, in the SCR_WIDTH x SCR_HEIGHT
+    // layout space the UI is drawn in whatever the window size
+    int width = 0, height = 0;
+    glfwGetWindowSize(window, &width, &height);
+    if (width > 0 && height > 0) {
+        xpos *= (double)SCR_WIDTH / width;
+        ypos *= (double)SCR_HEIGHT / height;
+    }
     mouseX = xpos;
     mouseY = SCR_HEIGHT - ypos; // Flip Y coordinate (OpenGL uses bottom-left origin)
 
@@ -931,7 +5704,7 @@ static void mouse_button_callback(GLFWwindow* window, int button, int action, in
             mouseButtonPressed = true;
 
             // Check if start button was clicked
-            if (currentGameState == GameState::START_SCREEN && startButton.isHovered) {
+            if (currentGameState == GameState::START_SCREEN && startButton.isHovered && Loader_IsDone()) {
                 startButton.isPressed = true;
             }
 
@@ -978,43 +5751,67 @@ static void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 
 
 // ===================== Rendering helpers =====================
-static void drawModelAt(Shader& shader, Model& m, const glm::vec3& pos, float yawDeg = 0.0f, float scale = 1.0f)
+// After the scene pass: occlusion-test every section and drawn obstacle against
+// the depth just rendered, for the next frames (see Occlusion Culling). `cubeVAO`
+// is a 36-vertex [-1, 1] cube, `boxShader` a position-only depth program.
+static void testOcclusion(ShaderProgram& boxShader, const glm::mat4& viewProjection, const glm::vec3& viewPos, GLuint cubeVAO)
+{
+    boxShader.use();
+    boxShader.setMat4("lightSpaceMatrix", viewProjection); // depth.vs: lightSpaceMatrix * model
+    GLState_BindVertexArray(cubeVAO);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    GLState_DepthFunc(GL_LEQUAL);
+    for (Section& s : sections) {
+        if (s.batch >= 0) {
+            const SectionBatch& b = g_sectionBatches[s.batch];
+            s.occlusion.boxMin = b.boxMin + glm::vec3(s.centerX, 0.0f, 0.0f);
+            s.occlusion.boxMax = b.boxMax + glm::vec3(s.centerX, 0.0f, 0.0f);
+            Occlusion_Test(s.occlusion, viewPos, boxShader);
+        }
+        for (Obstacle& o : s.laneObstacles)
+            if (o.type == ObstacleType::Car || o.type == ObstacleType::Jump || o.type == ObstacleType::Slide)
+                Occlusion_Test(o.occlusion, viewPos, boxShader); // box set by Variants_Add
+    }
+    GLState_DepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// Queue every mesh of a model at `pos`. Scale is uniform on purpose: main.vs
+// uses mat3(model) as the normal matrix
+static void queueModelAt(ShaderProgram& shader, const RenderModel& m, const glm::vec3& pos, float yawDeg, float scale, RenderPass pass)
 {
     glm::mat4 M(1.0f);
     M = glm::translate(M, pos);
     if (yawDeg != 0.0f) M = glm::rotate(M, glm::radians(yawDeg), glm::vec3(0, 1, 0));
     M = glm::scale(M, glm::vec3(scale));
-    shader.setMat4("model", M);
-    m.Draw(shader); // Model::Draw expects Shader& in model_animation.h
+    float distance = RenderQueue_Distance(pos);
+    for (const RenderMesh& mesh : m.meshes) {
+        DrawItem d;
+        d.program = &shader;
+        d.vao = mesh.VAO;
+        if (pass != PASS_SHADOW) d.texture = mesh.diffuseTexture;
+        d.key = RenderQueue_Key(pass, shader, d.texture, mesh.VAO, distance);
+        d.count = mesh.indexCount;
+        d.hasModel = true;
+        d.model = M;
+        RenderQueue_Submit(d);
+    }
 }
 
-// Render a button
-static void renderButton(Shader& uiShader, GLuint VAO, const Button& btn) {
+// Render a flat-coloured rectangle in screen coordinates
+// (the UI shader's projection is set once at startup)
+static void renderQuad(ShaderProgram& uiShader, GLuint VAO, float x, float y, float width, float height, const glm::vec3& color)
+{
     uiShader.use();
+    uiShader.setVec3("color", color);
 
-    // Set color based on button state
-    glm::vec3 buttonColor;
-    if (btn.isPressed && btn.isHovered) {
-        buttonColor = glm::vec3(0.2f, 0.5f, 0.2f); // Dark green when pressed
-    }
-    else if (btn.isHovered) {
-        buttonColor = glm::vec3(0.3f, 0.7f, 0.3f); // Light green when hovered
-    }
-    else {
-        buttonColor = glm::vec3(0.2f, 0.6f, 0.2f); // Normal green
-    }
-
-    uiShader.setVec3("color", buttonColor);
-
-    // Create orthographic projection for screen coordinates
-    glm::mat4 projection = glm::ortho(0.0f, (float)SCR_WIDTH, 0.0f, (float)SCR_HEIGHT);
-    uiShader.setMat4("projection", projection);
-
-    // Update button vertices
-    float left = btn.x - btn.width / 2.0f;
-    float right = btn.x + btn.width / 2.0f;
-    float bottom = btn.y - btn.height / 2.0f;
-    float top = btn.y + btn.height / 2.0f;
+    // Update quad vertices
+    float left = x - width / 2.0f;
+    float right = x + width / 2.0f;
+    float bottom = y - height / 2.0f;
+    float top = y + height / 2.0f;
 
     float vertices[] = {
         left, bottom,
@@ -1025,18 +5822,30 @@ static void renderButton(Shader& uiShader, GLuint VAO, const Button& btn) {
         left, top
     };
 
-    GLuint VBO;
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_DYNAMIC_DRAW);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    StreamRange range = Stream_Upload(vertices, sizeof(vertices));
+    GLState_BindVertexArray(VAO);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, range.buffer);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)range.offset);
     glEnableVertexAttribArray(0);
 
     glDrawArrays(GL_TRIANGLES, 0, 6);
+}
+
+// Render a button
+static void renderButton(ShaderProgram& uiShader, GLuint VAO, const Button& btn) {
+    // Set color based on button state
+    glm::vec3 buttonColor;
+    if (btn.isPressed && btn.isHovered) {
+        buttonColor = glm::vec3(0.2f, 0.5f, 0.2f); // Dark green when pressed
+    }
+    else if (btn.isHovered) {
+        buttonColor = glm::vec3(0.3f, 0.7f, 0.3f); // Light green when hovered
+    }
+    else {
+        buttonColor = glm::vec3(0.2f, 0.6f, 0.2f); // Normal green
+    }
 
-    glBindVertexArray(0);
-    glDeleteBuffers(1, &VBO);
+    renderQuad(uiShader, VAO, btn.x, btn.y, btn.width, btn.height, buttonColor);
 }
 
 // ===================== Text Rendering Functions =====================
@@ -1052,8 +5861,9 @@ static bool initTextRendering() {
 
     // Load font as face
     FT_Face face;
-    std::string fontPath = FileSystem::getPath("resources/fonts/Antonio-Regular.ttf");
-    if (FT_New_Face(ft, fontPath.c_str(), 0, &face)) {
+    std::string fontPath = "resources/fonts/Antonio-Regular.ttf";
+    AssetBlob font;
+    if (!Assets_Open(fontPath, font) || FT_New_Memory_Face(ft, font.data, (FT_Long)font.size, 0, &face)) {
         std::cerr << "ERROR::FREETYPE: Failed to load font at: " << fontPath << std::endl;
         FT_Done_FreeType(ft);
         return false;
@@ -1076,7 +5886,7 @@ static bool initTextRendering() {
         // Generate texture
         unsigned int texture;
         glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
+        GLState_BindTexture(GL_TEXTURE_2D, texture);
         glTexImage2D(
             GL_TEXTURE_2D,
             0,
@@ -1104,36 +5914,33 @@ static bool initTextRendering() {
         };
         Characters.insert(std::pair<char, Character>(c, character));
     }
-    glBindTexture(GL_TEXTURE_2D, 0);
+    GLState_BindTexture(GL_TEXTURE_2D, 0);
 
     // Destroy FreeType once we're finished
     FT_Done_Face(face);
     FT_Done_FreeType(ft);
 
-    // Configure VAO/VBO for texture quads
+    // VAO for texture quads; vertices are streamed per string (see RenderText)
     glGenVertexArrays(1, &textVAO);
-    glGenBuffers(1, &textVBO);
-    glBindVertexArray(textVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
+    GLState_BindVertexArray(textVAO);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    GLState_BindVertexArray(0);
 
     std::cout << "Text rendering initialized successfully\n";
     return true;
 }
 
 // Render text
-static void RenderText(Shader& shader, std::string text, float x, float y, float scale, glm::vec3 color) {
+static void RenderText(ShaderProgram& shader, std::string text, float x, float y, float scale, glm::vec3 color) {
     // Activate corresponding render state	
     shader.use();
-    glUniform3f(glGetUniformLocation(shader.ID, "textColor"), color.x, color.y, color.z);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(textVAO);
+    shader.setVec3("textColor", color);
+    GLState_ActiveTexture(GL_TEXTURE0);
+    if (text.empty()) return;
 
-    // Iterate through all characters
+    // Build the whole string's quads and stream them up in one go
+    std::vector<float> vertices;
+    vertices.reserve(text.size() * 6 * 4);
     std::string::const_iterator c;
     for (c = text.begin(); c != text.end(); c++) {
         Character ch = Characters[*c];
@@ -1144,8 +5951,7 @@ static void RenderText(Shader& shader, std::string text, float x, float y, float
         float w = ch.Size.x * scale;
         float h = ch.Size.y * scale;
 
-        // Update VBO for each character
-        float vertices[6][4] = {
+        float quad[6][4] = {
             { xpos,     ypos + h,   0.0f, 0.0f },
             { xpos,     ypos,       0.0f, 1.0f },
             { xpos + w, ypos,       1.0f, 1.0f },
@@ -1154,23 +5960,21 @@ static void RenderText(Shader& shader, std::string text, float x, float y, float
             { xpos + w, ypos,       1.0f, 1.0f },
             { xpos + w, ypos + h,   1.0f, 0.0f }
         };
-
-        // Render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-
-        // Update content of VBO memory
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-        // Render quad
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        vertices.insert(vertices.end(), &quad[0][0], &quad[0][0] + 6 * 4);
 
         // Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         x += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64)
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    StreamRange range = Stream_Upload(vertices.data(), vertices.size() * sizeof(float));
+    GLState_BindVertexArray(textVAO);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, range.buffer);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)range.offset);
+
+    // One quad per glyph, each with its own glyph texture
+    for (size_t i = 0; i < text.size(); ++i) {
+        GLState_BindTexture(GL_TEXTURE_2D, Characters[text[i]].TextureID);
+        glDrawArrays(GL_TRIANGLES, (GLint)(i * 6), 6);
+    }
 }
 
 // Helper function to calculate the actual width of text for proper centering
@@ -1183,31 +5987,110 @@ static float GetTextWidth(const std::string& text, float scale) {
     return width;
 }
 
+// Start screen; while assets are still loading (progress < 1) a progress bar
+// takes the place of the start button
+static void renderStartScreen(ShaderProgram& uiShader, GLuint buttonVAO, float progress)
+{
+    // Render plain color screen (dark blue)
+    glClearColor(0.1f, 0.15f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // Disable depth test for 2D UI rendering
+    GLState_Disable(GL_DEPTH_TEST);
+
+    // Enable blending for text rendering
+    GLState_Enable(GL_BLEND);
+    GLState_BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (progress < 1.0f) {
+        // Progress bar (track + fill, left-aligned)
+        const float barWidth = 400.0f, barHeight = 24.0f;
+        float barX = SCR_WIDTH / 2.0f;
+        float barY = SCR_HEIGHT / 2.0f;
+        renderQuad(uiShader, buttonVAO, barX, barY, barWidth, barHeight, glm::vec3(0.05f, 0.08f, 0.15f));
+        float fillWidth = barWidth * progress;
+        renderQuad(uiShader, buttonVAO, barX - (barWidth - fillWidth) / 2.0f, barY, fillWidth, barHeight, glm::vec3(0.2f, 0.6f, 0.2f));
+
+        std::string loadingText = "Loading... " + std::to_string((int)(progress * 100.0f)) + "%";
+        float loadingScale = 0.5f;
+        float loadingWidth = GetTextWidth(loadingText, loadingScale);
+        RenderText(*textShader, loadingText, (SCR_WIDTH - loadingWidth) / 2.0f, barY - 60.0f, loadingScale, glm::vec3(0.8f, 0.8f, 0.8f));
+    }
+    else {
+        // Render the start button
+        renderButton(uiShader, buttonVAO, startButton);
+
+        // Render text on the button (centered)
+        std::string buttonText = "START";
+        float textScale = 1.0f;
+        float textWidth = GetTextWidth(buttonText, textScale);
+        float textX = (SCR_WIDTH - textWidth) / 2.0f;
+        float textY = startButton.y - 15.0f;
+        RenderText(*textShader, buttonText, textX, textY, textScale, glm::vec3(1.0f, 1.0f, 1.0f));
+
+        // Render instructions (centered)
+        std::string instructionText = "Click button or press SPACE to start";
+        float instrScale = 0.5f;
+        float instrWidth = GetTextWidth(instructionText, instrScale);
+        float instrX = (SCR_WIDTH - instrWidth) / 2.0f;
+        float instrY = 100.0f;
+        RenderText(*textShader, instructionText, instrX, instrY, instrScale, glm::vec3(0.8f, 0.8f, 0.8f));
+    }
+
+    // Render title text (centered)
+    std::string titleText = "ROAD RUNNER";
+    float titleScale = 1.5f;
+    float titleWidth = GetTextWidth(titleText, titleScale);
+    float titleX = (SCR_WIDTH - titleWidth) / 2.0f;
+    float titleY = SCR_HEIGHT - 150.0f;
+    RenderText(*textShader, titleText, titleX, titleY, titleScale, glm::vec3(1.0f, 1.0f, 0.0f));
+
+    GLState_Disable(GL_BLEND);
+
+    // Re-enable depth test for 3D rendering
+    GLState_Enable(GL_DEPTH_TEST);
+}
+
 // ===================== Skybox loader =====================
-static GLuint loadCubemap(const std::vector<std::string>& faces)
+// worker thread: decode the six faces (cubemap faces are not flipped)
+static std::vector<DecodedImage> decodeCubemapFaces(const std::vector<std::string>& faces)
+{
+    std::vector<DecodedImage> images(faces.size());
+    for (size_t i = 0; i < faces.size(); ++i) {
+        if (!loadTextureImage(faces[i], false, images[i])) std::cerr << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
+    }
+    return images;
+}
+
+// main thread: upload decoded faces and free them. Cached faces bring their own
+// mip chain; only sample mips when every face has one.
+static GLuint createCubemap(std::vector<DecodedImage>& faces)
 {
     GLuint textureID;
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+    GLState_BindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-    int width, height, nrChannels;
+    bool mipmapped = true;
     for (unsigned int i = 0; i < faces.size(); ++i) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-            GLenum format = GL_RGB;
-            if (nrChannels == 1) format = GL_RED;
-            else if (nrChannels == 3) format = GL_RGB;
-            else if (nrChannels == 4) format = GL_RGBA;
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else {
-            std::cerr << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
+        DecodedImage& img = faces[i];
+        if (!img.loaded()) { mipmapped = false; continue; }
+        if (img.compressed.data) {
+            uploadCompressedLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, img);
+            img.compressed = AssetBlob();
+            continue;
         }
+        mipmapped = false;
+        GLenum format = GL_RGB;
+        if (img.channels == 1) format = GL_RED;
+        else if (img.channels == 3) format = GL_RGB;
+        else if (img.channels == 4) format = GL_RGBA;
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
+            0, format, img.width, img.height, 0, format, GL_UNSIGNED_BYTE, img.pixels);
+        stbi_image_free(img.pixels);
+        img.pixels = nullptr;
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    if (!mipmapped) glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
@@ -1216,98 +6099,119 @@ static GLuint loadCubemap(const std::vector<std::string>& faces)
     return textureID;
 }
 
+static void Loader_LoadCubemapAsync(const std::vector<std::string>& faces, GLuint& target)
+{
+    ++g_assetsTotal;
+    GLuint* out = &target;
+    Jobs_Submit([faces, out]() {
+        auto images = std::make_shared<std::vector<DecodedImage>>(decodeCubemapFaces(faces));
+        Loader_QueueUploads({ [images, out]() {
+            *out = createCubemap(*images);
+            ++g_assetsDone;
+        } });
+    });
+}
+
 // ===================== Callbacks =====================
-void framebuffer_size_callback(GLFWwindow*, int w, int h) { glViewport(0, 0, w, h); }
+void framebuffer_size_callback(GLFWwindow*, int w, int h)
+{
+    glViewport(0, 0, w, h);
+    if (w > 0 && h > 0) { g_windowWidth = w; g_windowHeight = h; } // scene target follows (DynRes_Resize)
+}
 
 // ===================== Main =====================
-int main()
+int main(int argc, char** argv)
 {
+    // Offline asset steps: `RoadRunner --bake` writes .rrmesh files, `--pack` builds
+    // the resource pack; both exit without opening a window
+    // Anything else of the form --key=value overrides RoadRunner.cfg (see Settings)
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--bake") return bakeAllModels();
+        if (arg == "--pack") return buildResourcePack();
+        size_t eq = arg.find('=');
+        if (arg.rfind("--", 0) == 0 && eq != std::string::npos) g_settingsArgs.emplace_back(arg.substr(2, eq - 2), arg.substr(eq + 1));
+        else std::cerr << "Ignoring argument " << arg << "\n";
+    }
+    g_settings = Settings_Load();
+
+    // Optional: everything below reads loose files when there is no pack
+    Pack_Open(FileSystem::getPath(PACK_FILE));
+
     if (!glfwInit()) { std::cerr << "Failed to init GLFW\n"; return -1; }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // 4.3 for the indirect draw path where the driver has it, 3.3 otherwise
+    GLFWwindow* window = nullptr;
+#ifndef __APPLE__
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    window = glfwCreateWindow(g_settings.windowWidth, g_settings.windowHeight, "RoadRunner", nullptr, nullptr);
+#endif
+    if (!window) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 #ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
-
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "RoadRunner", nullptr, nullptr);
+        window = glfwCreateWindow(g_settings.windowWidth, g_settings.windowHeight, "RoadRunner", nullptr, nullptr);
+    }
     if (!window) { std::cerr << "Failed to create window\n"; glfwTerminate(); return -1; }
     glfwMakeContextCurrent(window);
+    glfwGetFramebufferSize(window, &g_windowWidth, &g_windowHeight);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetScrollCallback(window, scroll_callback);
+    glfwSetKeyCallback(window, key_callback);
 
     // start with cursor visible; debug mode will capture it
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) { std::cerr << "Failed to init GLAD\n"; return -1; }
+    detectTextureCompression();
+    ShaderCache_Init();
+    Stream_Init();
 
     // Default: models/textures loaded with vertical flip enabled (most model textures expect this)
     stbi_set_flip_vertically_on_load(true);
 
-    glEnable(GL_DEPTH_TEST);
+    GLState_Enable(GL_DEPTH_TEST);
 
-    Shader shader(
-        FileSystem::getPath("src/3.model_loading/1.model_loading/main.vs").c_str(),
-        FileSystem::getPath("src/3.model_loading/1.model_loading/main.fs").c_str()
-    );
+    // Static and skinned variants of the world shader; only the player is skinned
+    ShaderProgram shader("main.vs", "main.fs");
     shader.use();
     shader.setInt("texture_diffuse1", 0);
-
-    Shader skyboxShader(
-        FileSystem::getPath("src/3.model_loading/1.model_loading/skybox.vs").c_str(),
-        FileSystem::getPath("src/3.model_loading/1.model_loading/skybox.fs").c_str()
-    );
+    ShaderProgram skinnedShader("main.vs", "main.fs", { "SKINNED" });
+    skinnedShader.use();
+    skinnedShader.setInt("texture_diffuse1", 0);
+    ShaderProgram batchedShader("main.vs", "main.fs", { "BATCHED" }); // section batches
+    batchedShader.use();
+    setTextureArrayUnits(batchedShader);
+    ShaderProgram instancedShader("main.vs", "main.fs", { "INSTANCED" }); // obstacle variants
+    instancedShader.use();
+    setTextureArrayUnits(instancedShader);
+
+    ShaderProgram skyboxShader("skybox.vs", "skybox.fs");
     skyboxShader.use();
     skyboxShader.setInt("skybox", 0);
 
     // Depth/shadow shader and shadow map setup
-    Shader depthShader(
-        FileSystem::getPath("src/3.model_loading/1.model_loading/depth.vs").c_str(),
-        FileSystem::getPath("src/3.model_loading/1.model_loading/depth.fs").c_str()
-    );
+    ShaderProgram depthShader("depth.vs", "depth.fs");
+    ShaderProgram depthSkinnedShader("depth.vs", "depth.fs", { "SKINNED" });
+    ShaderProgram depthInstancedShader("depth.vs", "depth.fs", { "INSTANCED" });
+    ShaderProgram occlusionBoxShader("depth.vs", "depth.fs"); // bounding boxes for occlusion queries
 
-    // Shadow map size
-    const unsigned int SHADOW_WIDTH = 2048, SHADOW_HEIGHT = 2048;
-    GLuint depthMapFBO;
-    glGenFramebuffers(1, &depthMapFBO);
-
-    // Create depth texture
-    GLuint depthMap;
-    glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-    // Attach depth texture as FBO's depth buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "Shadow Framebuffer not complete!\n";
-    }
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Cascaded shadow map (size and count from the settings), vsync, view distance...
+    Settings_Apply(window, g_settings);
 
     // Create UI shader from external files
-    Shader uiShader(
-        FileSystem::getPath("src/3.model_loading/1.model_loading/ui.vs").c_str(),
-        FileSystem::getPath("src/3.model_loading/1.model_loading/ui.fs").c_str()
-    );
+    ShaderProgram uiShader("ui.vs", "ui.fs");
     GLuint buttonVAO;
     glGenVertexArrays(1, &buttonVAO);
 
     // Initialize text rendering system
-    textShader = new Shader(
-        FileSystem::getPath("src/3.model_loading/1.model_loading/text.vs").c_str(),
-        FileSystem::getPath("src/3.model_loading/1.model_loading/text.fs").c_str()
-    );
+    textShader = new ShaderProgram("text.vs", "text.fs");
 
     if (!initTextRendering()) {
         std::cerr << "Failed to initialize text rendering\n";
@@ -1317,112 +6221,69 @@ int main()
     // Set up text shader projection (orthographic for screen space)
     glm::mat4 textProjection = glm::ortho(0.0f, (float)SCR_WIDTH, 0.0f, (float)SCR_HEIGHT);
     textShader->use();
-    glUniformMatrix4fv(glGetUniformLocation(textShader->ID, "projection"), 1, GL_FALSE, glm::value_ptr(textProjection));
+    textShader->setMat4("projection", textProjection);
+    uiShader.use();
+    uiShader.setMat4("projection", textProjection); // same screen-space projection for UI quads
 
     // Load Models (validate paths)
     const std::string base = "resources/objects";
     auto resolveAndCheck = [&](const std::string& rel) -> std::string {
-        std::string full = FileSystem::getPath(rel);
-        if (full.empty()) return "";
-        std::ifstream f(full);
-        if (!f.good()) return "";
-        return full;
+        return Assets_Exists(rel) ? rel : "";
         };
 
+    // Start workers; models, clips and the skybox are parsed/decoded in the
+    // background and uploaded from the loading loop below
+    stbi_set_flip_vertically_on_load(false);
+    Jobs_Init();
+
     // Load player model and animations
     // Load the BASE MODEL (static T-pose or bind pose) - this should be a separate file
-    std::string playerModelPath = resolveAndCheck(base + "/RoadRunner/player.dae");
+    const std::string modelDir = base + "/RoadRunner/";
+    std::string playerModelPath = resolveAndCheck(modelDir + PLAYER_MODEL_FILE);
     if (playerModelPath.empty()) {
-        std::cerr << "Failed to load player model, trying Treadmill Running.dae as fallback\n";
-        playerModelPath = resolveAndCheck(base + "/RoadRunner/Treadmill Running.dae");
-        if (playerModelPath.empty()) return -1;
+        std::cerr << "Failed to load player model, trying " << PLAYER_FALLBACK_MODEL_FILE << " as fallback\n";
+        playerModelPath = resolveAndCheck(modelDir + PLAYER_FALLBACK_MODEL_FILE);
+        if (playerModelPath.empty()) { Jobs_Shutdown(); return -1; }
     }
-    modelPlayer = Model(playerModelPath);
-    std::cout << "Loaded player model from: " << playerModelPath << "\n";
-    std::cout << "Player model has " << modelPlayer.GetBoneCount() << " bones\n";
 
     // Load animations - these reference the model's bone structure
-    std::string runAnimPath = FileSystem::getPath(base + "/RoadRunner/Treadmill Running.dae");
-    std::string jumpAnimPath = FileSystem::getPath(base + "/RoadRunner/Jump.dae");
-    std::string slideAnimPath = FileSystem::getPath(base + "/RoadRunner/Running Slide.dae");
-    std::string sidestepLeftAnimPath = FileSystem::getPath(base + "/RoadRunner/Side Step Left.dae");
-    std::string sidestepRightAnimPath = FileSystem::getPath(base + "/RoadRunner/Side Step Right.dae");
-
-    std::cout << "Loading animations...\n";
-    Animation runAnimation(runAnimPath, &modelPlayer);
-    Animation jumpAnimation(jumpAnimPath, &modelPlayer);
-    Animation slideAnimation(slideAnimPath, &modelPlayer);
-    Animation sidestepLeftAnimation(sidestepLeftAnimPath, &modelPlayer);
-    Animation sidestepRightAnimation(sidestepRightAnimPath, &modelPlayer);
-
-
-    Animator animator(&runAnimation);
-    AnimState animState = RUNNING;
-    float blendAmount = 0.0f;
-    float blendRate = 5.0f;  // Changed from 0.055f - this is now per SECOND, not per frame!
-
-    // Debug: Force initial animation update
-    animator.UpdateAnimation(0.01f);
-    auto initialTransforms = animator.GetFinalBoneMatrices();
+    std::vector<std::string> animPaths;
+    for (const auto& f : PLAYER_ANIMATION_FILES) animPaths.push_back(modelDir + f);
+    std::vector<std::unique_ptr<Animation>> playerAnimations;
+    Loader_LoadAnimatedModelAsync(playerModelPath, modelPlayer, playerSkeleton, animPaths, playerAnimations);
 
     // Load static environment models
-    {
-        std::string p = resolveAndCheck(base + "/RoadRunner/Section.obj");
-        if (p.empty()) return -1;
-        modelSection = Model(p);
-        std::cout << "Loaded section model\n";
-
-        // load building variants into modelBuildings
-        auto tryLoadVariant = [&](const std::string& rel) {
-            std::string p2 = resolveAndCheck(rel);
-            if (p2.empty()) { return false; }
-            modelBuildings.emplace_back(p2);
-            std::cout << "Loaded " << rel << " model\n";
-            return true;
-            };
-
-        tryLoadVariant(base + "/RoadRunner/Building1.obj");
-        tryLoadVariant(base + "/RoadRunner/Building2.obj");
-        tryLoadVariant(base + "/RoadRunner/Building3.obj");
-        tryLoadVariant(base + "/RoadRunner/Building4.obj");
-
-        p = resolveAndCheck(base + "/RoadRunner/Wires.obj");
-        if (!p.empty()) { modelWires = Model(p); std::cout << "Loaded wires model\n"; }
-    }
-
-    auto tryLoadVariantGeneric = [&](const std::string& rel, std::vector<Model>& list, const char*) {
-        std::string p = resolveAndCheck(rel);
-        if (p.empty()) return false;
-        list.emplace_back(p);
-        std::cout << "Loaded " << rel << " model\n";
-        return true;
+    std::string sectionPath = resolveAndCheck(modelDir + SECTION_MODEL_FILE);
+    if (sectionPath.empty()) { Jobs_Shutdown(); return -1; }
+    modelSection.keepGeometry = true; // merged into per-section batches
+    Loader_LoadModelAsync(sectionPath, modelSection);
+
+    std::string wiresPath = resolveAndCheck(modelDir + WIRES_MODEL_FILE);
+    if (!wiresPath.empty()) Loader_LoadModelAsync(wiresPath, modelWires);
+
+    // Variant lists are sized up front (missing files skipped) so each slot keeps
+    // a stable address while its upload is pending
+    auto loadVariantsAsync = [&](const std::vector<std::string>& files, std::vector<RenderModel>& list, bool keepGeometry = false) {
+        std::vector<std::string> found;
+        for (const auto& f : files) {
+            std::string p = resolveAndCheck(modelDir + f);
+            if (!p.empty()) found.push_back(p);
+        }
+        list.assign(found.size(), RenderModel());
+        for (size_t i = 0; i < found.size(); ++i) {
+            list[i].keepGeometry = keepGeometry;
+            Loader_LoadModelAsync(found[i], list[i]);
+        }
         };
 
-    modelCars.clear();
-    tryLoadVariantGeneric(base + "/RoadRunner/Taxi.obj", modelCars, "car");
-    tryLoadVariantGeneric(base + "/RoadRunner/Police.obj", modelCars, "car");
-    tryLoadVariantGeneric(base + "/RoadRunner/SUV.obj", modelCars, "car");
-    tryLoadVariantGeneric(base + "/RoadRunner/TukTuk.obj", modelCars, "car");
-
-    modelJumps.clear();
-    tryLoadVariantGeneric(base + "/RoadRunner/Cart.obj", modelJumps, "jump");
-    tryLoadVariantGeneric(base + "/RoadRunner/TrashBin.obj", modelJumps, "jump");
-
-    modelSlides.clear();
-    tryLoadVariantGeneric(base + "/RoadRunner/Barrier.obj", modelSlides, "slide");
+    loadVariantsAsync(BUILDING_MODEL_FILES, modelBuildings, true);
+    loadVariantsAsync(CAR_MODEL_FILES, modelCars, true);
+    loadVariantsAsync(JUMP_MODEL_FILES, modelJumps, true);
+    loadVariantsAsync(SLIDE_MODEL_FILES, modelSlides, true);
 
     // Skybox setup
-    stbi_set_flip_vertically_on_load(false);
-    std::vector<std::string> faces{
-        FileSystem::getPath("resources/textures/skybox/right.jpg"),
-        FileSystem::getPath("resources/textures/skybox/left.jpg"),
-        FileSystem::getPath("resources/textures/skybox/top.jpg"),
-        FileSystem::getPath("resources/textures/skybox/bottom.jpg"),
-        FileSystem::getPath("resources/textures/skybox/front.jpg"),
-        FileSystem::getPath("resources/textures/skybox/back.jpg")
-    };
-    GLuint cubemapTexture = loadCubemap(faces);
-    stbi_set_flip_vertically_on_load(true);
+    GLuint cubemapTexture = 0;
+    Loader_LoadCubemapAsync(SKYBOX_FACE_FILES, cubemapTexture);
 
     float skyboxVertices[] = {
         -1.0f,  1.0f, -1.0f,  -1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,
@@ -1442,12 +6303,73 @@ int main()
     GLuint skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
+    GLState_BindVertexArray(skyboxVAO);
+    GLState_BindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-    glBindVertexArray(0);
+    GLState_BindVertexArray(0);
+
+    // --- AUDIO: init and load (no separate header required) ---
+    Audio_Init();
+    Audio_LoadFiles(
+        "resources/audio/ambience.mp3",
+        "resources/audio/click.mp3",
+        "resources/audio/jump.wav",
+        "resources/audio/slide.mp3",
+        "resources/audio/running.mp3",
+        "resources/audio/fail.wav",
+        "resources/audio/engine.wav",
+        "resources/audio/horn.wav"
+    );
+    Audio_PlayAmbienceLoop();
+
+    // Loading loop: the start screen is up immediately with a progress bar while
+    // workers parse/decode and GL uploads are drained a few milliseconds per frame
+    while (!glfwWindowShouldClose(window) && !Loader_IsDone()) {
+        if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) glfwSetWindowShouldClose(window, true);
+        g_inputEvents.clear(); // nothing else takes keys while loading
+        Stream_BeginFrame();
+        Loader_DrainUploads(UPLOAD_BUDGET_SECONDS);
+        renderStartScreen(uiShader, buttonVAO, Loader_Progress());
+        Pacing_EndFrame(window, false); // the progress bar moves
+    }
+    if (glfwWindowShouldClose(window)) {
+        Jobs_Shutdown();
+        Audio_Shutdown();
+        Pack_Close();
+        glfwTerminate();
+        return 0;
+    }
+    stbi_set_flip_vertically_on_load(true);
+    size_t lodTriangles[LOD_COUNT] = {};
+    for (auto* list : { &modelBuildings, &modelCars, &modelJumps, &modelSlides })
+        for (const RenderModel& m : *list)
+            for (int level = 0; level < LOD_COUNT; ++level) lodTriangles[level] += Lod_TriangleCount(Lod_Geometry(m, level));
+    std::cout << "LOD triangles (buildings + obstacles):";
+    for (int level = 0; level < LOD_COUNT; ++level) std::cout << " " << lodTriangles[level];
+    std::cout << "\n";
+    Batches_BuildTextureArray();
+    Variants_Build(g_carFamily, modelCars);
+    Variants_Build(g_jumpFamily, modelJumps);
+    Variants_Build(g_slideFamily, modelSlides);
+    Indirect_Init();
+
+    std::cout << "Player model has " << playerSkeleton.GetBoneCount() << " bones\n";
+    Animation& runAnimation = *playerAnimations[0];
+    Animation& jumpAnimation = *playerAnimations[1];
+    Animation& slideAnimation = *playerAnimations[2];
+    Animation& sidestepLeftAnimation = *playerAnimations[3];
+    Animation& sidestepRightAnimation = *playerAnimations[4];
+
+    Animator animator(&runAnimation);
+    AnimState animState = RUNNING;
+    float blendAmount = 0.0f;
+    float blendRate = 5.0f;  // Changed from 0.055f - this is now per SECOND, not per frame!
+
+    // Debug: Force initial animation update
+    animator.UpdateAnimation(0.01f);
+    auto initialTransforms = animator.GetFinalBoneMatrices();
 
     // spawn
     worldStartCenter = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -1455,7 +6377,7 @@ int main()
     player.pos = playerSpawnPos;
 
     // Pre-generate
-    generateSectionsUpTo(player.pos.x);
+    generateSectionsUpTo(player.pos.x, PLAYER_FORWARD_SPEED);
 
     // debug print timer (to avoid spamming every frame)
     float debugPrintTimer = 0.0f;
@@ -1465,75 +6387,22 @@ int main()
     // Slightly tilted if you want soft angled shadows: glm::vec3(0.1f, -1.0f, 0.05f)
     glm::vec3 lightDir = glm::normalize(glm::vec3(0.0f, -1.0f, 0.0f));
 
-    // --- AUDIO: init and load (no separate header required) ---
-    Audio_Init();
-    Audio_LoadFiles(
-        FileSystem::getPath("resources/audio/ambience.mp3"),
-        FileSystem::getPath("resources/audio/click.mp3"),
-        FileSystem::getPath("resources/audio/jump.wav"),
-        FileSystem::getPath("resources/audio/slide.mp3"),
-        FileSystem::getPath("resources/audio/running.mp3"),
-        FileSystem::getPath("resources/audio/fail.wav")
-    );
-    Audio_PlayAmbienceLoop();
-
     // Main loop
     while (!glfwWindowShouldClose(window)) {
         float t = (float)glfwGetTime();
         deltaTime = t - lastFrame; lastFrame = t;
-
-        // --- AUDIO: cleanup finished one-shot sounds ---
-        Audio_Update();
+        Profiler_NewFrame();
+        Stream_BeginFrame();
+        Settings_Poll(window);
 
         processInput(window);
+        Audio_PostTraffic(camera, currentGameState == GameState::PLAYING);
 
         // ===== START SCREEN STATE =====
         if (currentGameState == GameState::START_SCREEN) {
-            // Render plain color screen (dark blue)
-            glClearColor(0.1f, 0.15f, 0.3f, 1.0f);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-            // Disable depth test for 2D UI rendering
-            glDisable(GL_DEPTH_TEST);
-
-            // Enable blending for text rendering
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-
-            // Render the start button
-            renderButton(uiShader, buttonVAO, startButton);
-
-            // Render text on the button (centered)
-            std::string buttonText = "START";
-            float textScale = 1.0f;
-            float textWidth = GetTextWidth(buttonText, textScale);
-            float textX = (SCR_WIDTH - textWidth) / 2.0f;
-            float textY = startButton.y - 15.0f;
-            RenderText(*textShader, buttonText, textX, textY, textScale, glm::vec3(1.0f, 1.0f, 1.0f));
-
-            // Render title text (centered)
-            std::string titleText = "ROAD RUNNER";
-            float titleScale = 1.5f;
-            float titleWidth = GetTextWidth(titleText, titleScale);
-            float titleX = (SCR_WIDTH - titleWidth) / 2.0f;
-            float titleY = SCR_HEIGHT - 150.0f;
-            RenderText(*textShader, titleText, titleX, titleY, titleScale, glm::vec3(1.0f, 1.0f, 0.0f));
-
-            // Render instructions (centered)
-            std::string instructionText = "Click button or press SPACE to start";
-            float instrScale = 0.5f;
-            float instrWidth = GetTextWidth(instructionText, instrScale);
-            float instrX = (SCR_WIDTH - instrWidth) / 2.0f;
-            float instrY = 100.0f;
-            RenderText(*textShader, instructionText, instrX, instrY, instrScale, glm::vec3(0.8f, 0.8f, 0.8f));
-
-            glDisable(GL_BLEND);
+            renderStartScreen(uiShader, buttonVAO, 1.0f);
 
-            // Re-enable depth test for 3D rendering
-            glEnable(GL_DEPTH_TEST);
-
-            glfwSwapBuffers(window);
-            glfwPollEvents();
+            Pacing_EndFrame(window, true);
             continue; // Skip game logic
         }
 
@@ -1544,11 +6413,11 @@ int main()
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             // Disable depth test for 2D UI rendering
-            glDisable(GL_DEPTH_TEST);
+            GLState_Disable(GL_DEPTH_TEST);
 
             // Enable blending for text rendering
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            GLState_Enable(GL_BLEND);
+            GLState_BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
             // Render the restart button
             renderButton(uiShader, buttonVAO, restartButton);
@@ -1585,13 +6454,12 @@ int main()
             float instrY = 100.0f;
             RenderText(*textShader, instructionText, instrX, instrY, instrScale, glm::vec3(0.8f, 0.8f, 0.8f));
 
-            glDisable(GL_BLEND);
+            GLState_Disable(GL_BLEND);
 
             // Re-enable depth test for 3D rendering
-            glEnable(GL_DEPTH_TEST);
+            GLState_Enable(GL_DEPTH_TEST);
 
-            glfwSwapBuffers(window);
-            glfwPollEvents();
+            Pacing_EndFrame(window, true);
             continue; // Skip game logic
         }
 
@@ -1609,7 +6477,8 @@ int main()
             speedMultiplier = 1.9f;  // 110% of normal speed
         }
 
-        player.pos.x += PLAYER_FORWARD_SPEED * speedMultiplier * deltaTime;
+        float forwardSpeed = PLAYER_FORWARD_SPEED * speedMultiplier;
+        player.pos.x += forwardSpeed * deltaTime;
 
         // Smoothly interpolate Z position during sidestep
         if (player.isSidestepping) {
@@ -1870,7 +6739,8 @@ int main()
             camera.Pitch = 0.0f;
         }
 
-        generateSectionsUpTo(player.pos.x);
+        rebaseWorldOrigin();
+        generateSectionsUpTo(player.pos.x, forwardSpeed);
 
         // Check collision
         bool hit = checkHitObstacle(player);
@@ -1885,80 +6755,40 @@ int main()
             collisionPrintedLastFrame = false;
         }
 
-        // ---------- Shadow pass (render scene from light into depth map) ----------
-        // Compute light-space matrix that covers the playing area centered on player
-        float near_plane = 1.0f, far_plane = 200.0f;
-        float orthoSize = 120.0f; // adjust to your scene; bigger = more area covered but less precision
-        glm::mat4 lightProjection = glm::ortho(-orthoSize, orthoSize, -orthoSize, orthoSize, near_plane, far_plane);
-        // place light so it looks at the player's forward area
-        glm::vec3 lightPos = glm::vec3(player.pos.x, 40.0f, player.pos.z) - lightDir * 50.0f;
-        glm::mat4 lightView = glm::lookAt(lightPos, glm::vec3(player.pos.x, 0.0f, player.pos.z), glm::vec3(0.0f, 1.0f, 0.0f));
-        glm::mat4 lightSpaceMatrix = lightProjection * lightView;
-
-        // Render to depth map
-        glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-        glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-        glClear(GL_DEPTH_BUFFER_BIT);
-        depthShader.use();
-        depthShader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-
-        // Draw world to depth map
-        depthShader.setInt("isAnimated", 0);
-        for (auto& s : sections) {
-            glm::vec3 sectionPos(s.centerX, 0.0f, 0.0f);
-            drawModelAt(depthShader, modelSection, sectionPos, 0.0f, 1.0f);
-
-            if (!modelBuildings.empty()) {
-                glm::vec3 bL1(s.centerX + BUILDING_LENGTH * 0.5f, 0.0f, -(((LANE_COUNT - 1) * LANE_Z_SPACING) + (LANE_Z_SPACING / 2)) - SIDEWALK_WIDTH);
-                glm::vec3 bL2(s.centerX - BUILDING_LENGTH * 0.5f, 0.0f, -(((LANE_COUNT - 1) * LANE_Z_SPACING) + (LANE_Z_SPACING / 2)) - SIDEWALK_WIDTH);
-                glm::vec3 bR1(s.centerX + BUILDING_LENGTH * 0.5f, 0.0f, (((LANE_COUNT - 1) * LANE_Z_SPACING) + (LANE_Z_SPACING / 2)) + SIDEWALK_WIDTH);
-                glm::vec3 bR2(s.centerX - BUILDING_LENGTH * 0.5f, 0.0f, (((LANE_COUNT - 1) * LANE_Z_SPACING) + (LANE_Z_SPACING / 2)) + SIDEWALK_WIDTH);
-
-                const std::array<glm::vec3, 4> bpos = { bL1, bL2, bR1, bR2 };
-                for (int i = 0; i < 4; ++i) {
-                    int vid = s.buildingVariants[i];
-                    if (vid >= 0 && vid < (int)modelBuildings.size()) {
-                        float yaw = (i == 0 || i == 1) ? 180.0f : 0.0f;
-                        drawModelAt(depthShader, modelBuildings[vid], bpos[i], yaw, 1.0f);
-                    }
-                }
-            }
+        // ---------- Shadow pass (render scene from light into the cascades) ----------
+        // Fit the cascades that are due this frame around the view frustum
+        float aspect = (float)g_windowWidth / (float)g_windowHeight;
+        Shadows_Update(camera, aspect, CAM_NEAR_PLANE, lightDir);
+        glm::mat4 shadowCullMatrix = Shadows_CullMatrix();
 
-            if (s.hasWires && !modelWires.meshes.empty()) {
-                const Obstacle& w = s.laneObstacles[1];
-                drawModelAt(depthShader, modelWires, w.pos, 180.0f, 1.0f);
-            }
+        glm::mat4 P = glm::perspective(glm::radians(camera.Zoom), aspect, CAM_NEAR_PLANE, g_farPlane);
+        glm::mat4 V = glm::lookAt(camera.Position, camera.Position + camera.Front, camera.WorldUp);
 
-            for (int lane = 0; lane < LANE_COUNT; ++lane) {
-                const Obstacle& o = s.laneObstacles[lane];
-                if (o.type == ObstacleType::None || o.type == ObstacleType::Wires) continue;
-                float obsYaw = 180.0f;
-                if (o.type == ObstacleType::Car) {
-                    if (o.variantIndex >= 0 && o.variantIndex < (int)modelCars.size())
-                        drawModelAt(depthShader, modelCars[o.variantIndex], o.pos, obsYaw, 0.9f);
-                    else if (!modelCars.empty())
-                        drawModelAt(depthShader, modelCars[0], o.pos, obsYaw, 0.9f);
-                }
-                else if (o.type == ObstacleType::Jump) {
-                    if (o.variantIndex >= 0 && o.variantIndex < (int)modelJumps.size())
-                        drawModelAt(depthShader, modelJumps[o.variantIndex], o.pos, obsYaw, 0.9f);
-                    else if (!modelJumps.empty())
-                        drawModelAt(depthShader, modelJumps[0], o.pos, obsYaw, 0.9f);
-                }
-                else if (o.type == ObstacleType::Slide) {
-                    if (o.variantIndex >= 0 && o.variantIndex < (int)modelSlides.size())
-                        drawModelAt(depthShader, modelSlides[o.variantIndex], o.pos, obsYaw, 1.0f);
-                    else if (!modelSlides.empty())
-                        drawModelAt(depthShader, modelSlides[0], o.pos, obsYaw, 1.0f);
-                }
+        // LOD levels and obstacle instances for this frame, shared by the shadow and scene passes
+        Lod_BeginFrame(camera.Position, camera.Zoom);
+        RenderQueue_BeginFrame(camera.Position);
+        for (VariantFamily* f : { &g_carFamily, &g_jumpFamily, &g_slideFamily }) Variants_Clear(*f);
+        for (auto& s : sections) {
+            Batches_UpdateLod(s, deltaTime);
+            Occlusion_Poll(s.occlusion);
+            for (Obstacle& o : s.laneObstacles) {
+                Occlusion_Poll(o.occlusion);
+                if (o.type == ObstacleType::Car) Variants_Add(g_carFamily, o.variantIndex, o.pos, 180.0f, 0.9f, o.lod, o.occlusion, deltaTime);
+                else if (o.type == ObstacleType::Jump) Variants_Add(g_jumpFamily, o.variantIndex, o.pos, 180.0f, 0.9f, o.lod, o.occlusion, deltaTime);
+                else if (o.type == ObstacleType::Slide) Variants_Add(g_slideFamily, o.variantIndex, o.pos, 180.0f, 1.0f, o.lod, o.occlusion, deltaTime);
             }
         }
+        if (g_indirect.enabled) Indirect_BuildFrame(P * V, shadowCullMatrix);
+        else for (VariantFamily* f : { &g_carFamily, &g_jumpFamily, &g_slideFamily }) Variants_Upload(*f);
+
+        // Time the world on the GPU from here to the upscale (see Dynamic Resolution)
+        DynRes_BeginFrame();
 
-        // Draw animated player into depth map as well
-        depthShader.setInt("isAnimated", 1);
+        // Animated player pose for the depth maps
+        depthSkinnedShader.use();
         auto depthTransforms = animator.GetFinalBoneMatrices();
         for (int i = 0; i < depthTransforms.size(); ++i) {
-            depthShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", depthTransforms[i]);
+            depthSkinnedShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", depthTransforms[i]);
         }
         // Use same playerRenderPos logic as later (include vertical offsets so shadows follow)
         glm::vec3 playerDepthPos = player.pos;
@@ -1974,92 +6804,75 @@ int main()
         else if (player.isCrouching) {
             playerDepthPos.y = PLAYER_CROUCH_HEIGHT;
         }
-        drawModelAt(depthShader, modelPlayer, playerDepthPos, 90.0f, PLAYER_SCALE);
 
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        // Reset viewport for normal rendering
-        glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+        // Render each due cascade into its layer of the depth array
+        for (int c = 0; c < g_shadows.count; ++c) {
+            if (!g_shadows.cascades[c].due) continue;
+            const glm::mat4& lightSpaceMatrix = g_shadows.cascades[c].matrix;
+            Shadows_BeginCascade(c);
+            for (ShaderProgram* depth : { &depthShader, &depthInstancedShader, &depthSkinnedShader }) {
+                depth->use();
+                depth->setMat4("lightSpaceMatrix", lightSpaceMatrix);
+            }
+
+            // Queue world to depth map
+            for (auto& s : sections) {
+                if (!g_indirect.enabled) Batches_Queue(depthShader, s, PASS_SHADOW);
+
+                if (s.hasWires && !modelWires.meshes.empty()) {
+                    const Obstacle& w = s.laneObstacles[1];
+                    queueModelAt(depthShader, modelWires, w.pos, 180.0f, 1.0f, PASS_SHADOW);
+                }
+            }
+            // Sections and obstacles: one multi-draw per group, or one instanced draw per variant
+            if (g_indirect.enabled) Indirect_Queue(depthInstancedShader, PASS_SHADOW);
+            else for (const VariantFamily* f : { &g_carFamily, &g_jumpFamily, &g_slideFamily }) Variants_Queue(*f, depthInstancedShader, PASS_SHADOW);
+
+            queueModelAt(depthSkinnedShader, modelPlayer, playerDepthPos, 90.0f, PLAYER_SCALE, PASS_SHADOW);
+            RenderQueue_Flush();
+        }
+
+        // Scene goes to the scaled offscreen target
+        DynRes_BindScene();
 
         // Render
         glClearColor(0.05f, 0.05f, 0.07f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glm::mat4 P = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 500.0f);
-        glm::mat4 V = glm::lookAt(camera.Position, camera.Position + camera.Front, camera.WorldUp);
+        // Camera and lighting uniforms, shared by both world shader variants
+        auto setSceneUniforms = [&](ShaderProgram& s) {
+            s.use();
+            s.setMat4("projection", P);
+            s.setMat4("view", V);
+            s.setVec3("lightDir", lightDir);
+            s.setVec3("viewPos", camera.Position);
+            Shadows_SetUniforms(s);
+            s.setInt("shadowMap", 1);
+            };
 
-        // Use shader for world models
-        shader.use();
-        shader.setMat4("projection", P);
-        shader.setMat4("view", V);
-        shader.setInt("isAnimated", 0);
-
-        // Pass lighting uniforms
-        shader.setVec3("lightDir", lightDir);
-        shader.setVec3("viewPos", camera.Position);
-        shader.setMat4("lightSpaceMatrix", lightSpaceMatrix);
-        shader.setInt("shadowMap", 1);
-
-        // Bind shadow map to texture unit 1
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, depthMap);
-        glActiveTexture(GL_TEXTURE0);
-
-        // Draw generated sections
-        float roadHalf = ((LANE_COUNT - 1) * LANE_Z_SPACING) + (LANE_Z_SPACING / 2);
-        float buildingZLeft = -(roadHalf + SIDEWALK_WIDTH);
-        float buildingZRight = (roadHalf + SIDEWALK_WIDTH);
-        for (auto& s : sections) {
-            glm::vec3 sectionPos(s.centerX, 0.0f, 0.0f);
-            drawModelAt(shader, modelSection, sectionPos, 0.0f, 1.0f);
-
-            if (!modelBuildings.empty()) {
-                glm::vec3 bL1(s.centerX + BUILDING_LENGTH * 0.5f, 0.0f, buildingZLeft);
-                glm::vec3 bL2(s.centerX - BUILDING_LENGTH * 0.5f, 0.0f, buildingZLeft);
-                glm::vec3 bR1(s.centerX + BUILDING_LENGTH * 0.5f, 0.0f, buildingZRight);
-                glm::vec3 bR2(s.centerX - BUILDING_LENGTH * 0.5f, 0.0f, buildingZRight);
-
-                const std::array<glm::vec3, 4> bpos = { bL1, bL2, bR1, bR2 };
-                for (int i = 0; i < 4; ++i) {
-                    int vid = s.buildingVariants[i];
-                    if (vid >= 0 && vid < (int)modelBuildings.size()) {
-                        float yaw = (i == 0 || i == 1) ? 180.0f : 0.0f;
-                        drawModelAt(shader, modelBuildings[vid], bpos[i], yaw, 1.0f);
-                    }
-                }
-            }
+        // Bind the cascades to texture unit 1
+        GLState_ActiveTexture(GL_TEXTURE1);
+        GLState_BindTexture(GL_TEXTURE_2D_ARRAY, g_shadows.depthArray);
+        GLState_ActiveTexture(GL_TEXTURE0);
 
+        // Queue generated sections: merged road + buildings (one draw each) and wires
+        setSceneUniforms(batchedShader);
+        setSceneUniforms(shader);
+        for (auto& s : sections) {
+            if (!g_indirect.enabled) Batches_Queue(batchedShader, s, PASS_OPAQUE, true);
             if (s.hasWires && !modelWires.meshes.empty()) {
                 const Obstacle& w = s.laneObstacles[1];
-                drawModelAt(shader, modelWires, w.pos, 180.0f, 1.0f);
-            }
-
-            for (int lane = 0; lane < LANE_COUNT; ++lane) {
-                const Obstacle& o = s.laneObstacles[lane];
-                if (o.type == ObstacleType::None || o.type == ObstacleType::Wires) continue;
-                float obsYaw = 180.0f;
-                if (o.type == ObstacleType::Car) {
-                    if (o.variantIndex >= 0 && o.variantIndex < (int)modelCars.size())
-                        drawModelAt(shader, modelCars[o.variantIndex], o.pos, obsYaw, 0.9f);
-                    else if (!modelCars.empty())
-                        drawModelAt(shader, modelCars[0], o.pos, obsYaw, 0.9f);
-                }
-                else if (o.type == ObstacleType::Jump) {
-                    if (o.variantIndex >= 0 && o.variantIndex < (int)modelJumps.size())
-                        drawModelAt(shader, modelJumps[o.variantIndex], o.pos, obsYaw, 0.9f);
-                    else if (!modelJumps.empty())
-                        drawModelAt(shader, modelJumps[0], o.pos, obsYaw, 0.9f);
-                }
-                else if (o.type == ObstacleType::Slide) {
-                    if (o.variantIndex >= 0 && o.variantIndex < (int)modelSlides.size())
-                        drawModelAt(shader, modelSlides[o.variantIndex], o.pos, obsYaw, 1.0f);
-                    else if (!modelSlides.empty())
-                        drawModelAt(shader, modelSlides[0], o.pos, obsYaw, 1.0f);
-                }
+                queueModelAt(shader, modelWires, w.pos, 180.0f, 1.0f, PASS_OPAQUE);
             }
         }
 
-        // Draw animated player
-        shader.setInt("isAnimated", 1);
+        // Obstacles (and on the indirect path the sections too)
+        setSceneUniforms(instancedShader);
+        if (g_indirect.enabled) Indirect_Queue(instancedShader, PASS_OPAQUE);
+        else for (const VariantFamily* f : { &g_carFamily, &g_jumpFamily, &g_slideFamily }) Variants_Queue(*f, instancedShader, PASS_OPAQUE);
+
+        // Animated player
+        setSceneUniforms(skinnedShader);
         auto transforms = animator.GetFinalBoneMatrices();
 
         // Calculate player render position
@@ -2115,31 +6928,39 @@ int main()
         frameCount++;
 
         for (int i = 0; i < transforms.size(); ++i) {
-            shader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+            skinnedShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
         }
 
-        drawModelAt(shader, modelPlayer, playerRenderPos, 90.0f, PLAYER_SCALE);
+        queueModelAt(skinnedShader, modelPlayer, playerRenderPos, 90.0f, PLAYER_SCALE, PASS_OPAQUE);
 
-        // Draw skybox
-        glDepthFunc(GL_LEQUAL);
+        // Skybox sorts after all opaque draws; at depth 1.0 with GL_LEQUAL it only
+        // fills the pixels nothing else covered
         skyboxShader.use();
         glm::mat4 viewNoTrans = glm::mat4(glm::mat3(V));
         skyboxShader.setMat4("view", viewNoTrans);
         skyboxShader.setMat4("projection", P);
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
-
-        // ===== RENDER SCORE HUD =====
+        DrawItem sky;
+        sky.kind = DrawKind::Arrays;
+        sky.program = &skyboxShader;
+        sky.vao = skyboxVAO;
+        sky.textureTarget = GL_TEXTURE_CUBE_MAP;
+        sky.texture = cubemapTexture;
+        sky.count = 36;
+        sky.depthFunc = GL_LEQUAL;
+        sky.key = RenderQueue_Key(PASS_SKY, skyboxShader, cubemapTexture, skyboxVAO, 0.0f);
+        RenderQueue_Submit(sky);
+
+        RenderQueue_Flush();
+        testOcclusion(occlusionBoxShader, P * V, camera.Position, skyboxVAO);
+        DynRes_Resolve();
+
+        // ===== RENDER SCORE HUD (native resolution) =====
         // Disable depth test for 2D UI rendering
-        glDisable(GL_DEPTH_TEST);
+        GLState_Disable(GL_DEPTH_TEST);
 
         // Enable blending for text rendering
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        GLState_Enable(GL_BLEND);
+        GLState_BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
         // Render score in top-left corner
         std::string scoreText = "Score: " + std::to_string(player.score);
@@ -2147,17 +6968,22 @@ int main()
         float scoreX = 20.0f; // 20 pixels from left edge
         float scoreY = SCR_HEIGHT - 50.0f; // 50 pixels from top edge
         RenderText(*textShader, scoreText, scoreX, scoreY, scoreScale, glm::vec3(1.0f, 1.0f, 1.0f));
+        if (g_profilerOverlay) {
+            RenderText(*textShader, Profiler_Summary(0), scoreX, scoreY - 30.0f, 0.35f, glm::vec3(0.6f, 1.0f, 0.6f));
+            RenderText(*textShader, Profiler_Summary(1), scoreX, scoreY - 50.0f, 0.35f, glm::vec3(0.6f, 1.0f, 0.6f));
+        }
 
-        glDisable(GL_BLEND);
+        GLState_Disable(GL_BLEND);
 
         // Re-enable depth test for next frame
-        glEnable(GL_DEPTH_TEST);
+        GLState_Enable(GL_DEPTH_TEST);
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        Pacing_EndFrame(window, false);
     }
 
+    Jobs_Shutdown();
     Audio_Shutdown();
+    Pack_Close();
     glfwTerminate();
     return 0;
 }
\ No newline at end of file
@@ -1,27 +1,98 @@
 #version 330 core
+#if defined(BATCHED) || defined(INSTANCED)
+#define TEXTURE_ARRAY
+#endif
 out vec4 FragColor;
 
 in VS_OUT {
     vec2 TexCoords;
     vec3 FragPos;
     vec3 Normal;
+#ifdef TEXTURE_ARRAY
+    flat uint Material;
+    flat float LodFade;
+#endif
 } fs_in;
 
+#ifdef TEXTURE_ARRAY
+const int MAX_TEXTURE_ARRAYS = 6;   // see Texture Arrays in main.cpp
+uniform sampler2DArray texture_arrays[MAX_TEXTURE_ARRAYS];
+#else
 uniform sampler2D texture_diffuse1;
+#endif
+
+// Cascaded shadow map (see Shadow Cascades in main.cpp)
+const int MAX_SHADOW_CASCADES = 4;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 cascadeMatrices[MAX_SHADOW_CASCADES];
+uniform int cascadeCount;
+uniform vec3 lightDir;
+
+#ifdef TEXTURE_ARRAY
+// Material 0 is white, otherwise 1 + (array << 16 | layer). GLSL 3.30 only takes
+// constant sampler array indices and the branch isn't uniform, so gradients are
+// taken before it.
+vec4 sampleMaterial(vec2 uv, uint material)
+{
+    vec2 dx = dFdx(uv), dy = dFdy(uv);
+    if (material == 0u) return vec4(1.0);
+    uint array = (material - 1u) >> 16;
+    vec3 p = vec3(uv, float((material - 1u) & 0xFFFFu));
+    if (array == 0u) return textureGrad(texture_arrays[0], p, dx, dy);
+    if (array == 1u) return textureGrad(texture_arrays[1], p, dx, dy);
+    if (array == 2u) return textureGrad(texture_arrays[2], p, dx, dy);
+    if (array == 3u) return textureGrad(texture_arrays[3], p, dx, dy);
+    if (array == 4u) return textureGrad(texture_arrays[4], p, dx, dy);
+    return textureGrad(texture_arrays[5], p, dx, dy);
+}
+
+// 4x4 ordered dither for LOD cross-fades: the incoming level (LodFade > 0) keeps
+// the pixels below its fade, the outgoing one (< 0) the rest
+const float BAYER[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0,
+                                  3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+#endif
+
+// 1 = lit, 0 = shadowed: 3x3 PCF in the first cascade whose box holds the fragment
+float shadowFactor(vec3 normal)
+{
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float bias = max(0.002 * (1.0 - dot(normal, -lightDir)), 0.0005);
+    for (int c = 0; c < cascadeCount; ++c) {
+        vec4 p = cascadeMatrices[c] * vec4(fs_in.FragPos, 1.0);
+        vec3 uvz = p.xyz / p.w * 0.5 + 0.5;
+        if (any(lessThan(uvz.xy, texel * 2.0)) || any(greaterThan(uvz.xy, 1.0 - texel * 2.0)) || uvz.z > 1.0) continue;
+        float lit = 0.0;
+        for (int x = -1; x <= 1; ++x)
+            for (int y = -1; y <= 1; ++y)
+                lit += texture(shadowMap, vec4(uvz.xy + vec2(x, y) * texel, float(c), uvz.z - bias));
+        return lit / 9.0;
+    }
+    return 1.0;
+}
 
 void main()
 {    
+#ifdef TEXTURE_ARRAY
+    if (fs_in.LodFade != 0.0) {
+        ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+        float d = (BAYER[p.y * 4 + p.x] + 0.5) / 16.0;
+        if (fs_in.LodFade > 0.0 ? d >= fs_in.LodFade : d < -fs_in.LodFade) discard;
+    }
+#endif
     // Sample the texture (now contains material color)
+#ifdef TEXTURE_ARRAY
+    vec4 texColor = sampleMaterial(fs_in.TexCoords, fs_in.Material);
+#else
     vec4 texColor = texture(texture_diffuse1, fs_in.TexCoords);
+#endif
     
-    // Simple lighting with higher ambient
-    vec3 lightDir = normalize(vec3(1.0, 1.0, 1.0));
+    // Simple lighting with higher ambient; lightDir points from the sun, like the shadow map
     vec3 normal = normalize(fs_in.Normal);
     
     // Higher ambient light so colors are more visible
     float ambient = 0.5;
-    float diff = max(dot(normal, lightDir), 0.0);
-    float lighting = ambient + diff * 0.5;
+    float diff = max(dot(normal, -lightDir), 0.0);
+    float lighting = ambient + diff * 0.5 * shadowFactor(normal);
     
     // Apply lighting to texture color
     FragColor = vec4(texColor.rgb * lighting, texColor.a);
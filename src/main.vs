@@ -1,56 +1,91 @@
 #version 330 core
+// Compiled by ShaderProgram as static, SKINNED (the player), BATCHED (merged
+// section geometry with a texture array material per vertex) and INSTANCED
+// (obstacle variants: per-instance model matrix and LOD fade) variants.
+// Attribute locations match StaticVertex/SkinnedVertex in main.cpp (bones at 5/6).
+#if defined(BATCHED) || defined(INSTANCED)
+#define TEXTURE_ARRAY
+#endif
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
-// These are in the vertex buffer but we won't use them
-layout (location = 3) in vec3 aTangent;
-layout (location = 4) in vec3 aBitangent;
-// Animation attributes - CORRECT LOCATIONS NOW!
+#ifdef SKINNED
 layout (location = 5) in ivec4 aBoneIDs;
 layout (location = 6) in vec4  aWeights;
+#endif
+#ifdef TEXTURE_ARRAY
+layout (location = 7) in uint  aMaterial;  // see Texture Arrays in main.cpp (0 = white)
+#endif
+#ifdef INSTANCED
+layout (location = 8) in mat4  aModel;     // 8..11
+layout (location = 12) in float aLodFade;
+#endif
 
 out VS_OUT {
     vec2 TexCoords;
     vec3 FragPos;
     vec3 Normal;
+#ifdef TEXTURE_ARRAY
+    flat uint Material;
+    flat float LodFade;        // LOD cross-fade dither, see Lod_FadeIn
+#endif
 } vs_out;
 
 uniform mat4 model;
+#ifdef BATCHED
+uniform float lodFade;
+#endif
 uniform mat4 view;
 uniform mat4 projection;
 
-// Animation uniforms
+#ifdef SKINNED
 const int MAX_BONES = 100;
 uniform mat4 finalBonesMatrices[MAX_BONES];
-uniform int isAnimated; // 1 if animated, 0 if static
+#endif
 
 void main()
 {
     vec4 localPos = vec4(aPos, 1.0);
     vec3 localNormal = aNormal;
 
-    if (isAnimated == 1) {
-        // Calculate total weight
-        float totalWeight = aWeights.x + aWeights.y + aWeights.z + aWeights.w;
-        
-        // Apply bone transformations if we have valid weights
-        if (totalWeight > 0.01) {
-            mat4 boneTransform = mat4(0.0);
-            
-            for (int i = 0; i < 4; ++i) {
-                if (aWeights[i] > 0.0 && aBoneIDs[i] >= 0 && aBoneIDs[i] < MAX_BONES) {
-                    boneTransform += finalBonesMatrices[aBoneIDs[i]] * aWeights[i];
-                }
+#ifdef SKINNED
+    // Calculate total weight
+    float totalWeight = aWeights.x + aWeights.y + aWeights.z + aWeights.w;
+
+    // Apply bone transformations if we have valid weights
+    if (totalWeight > 0.01) {
+        mat4 boneTransform = mat4(0.0);
+
+        for (int i = 0; i < 4; ++i) {
+            if (aWeights[i] > 0.0 && aBoneIDs[i] >= 0 && aBoneIDs[i] < MAX_BONES) {
+                boneTransform += finalBonesMatrices[aBoneIDs[i]] * aWeights[i];
             }
-            
-            localPos = boneTransform * localPos;
-            localNormal = mat3(boneTransform) * localNormal;
         }
+
+        localPos = boneTransform * localPos;
+        localNormal = mat3(boneTransform) * localNormal;
     }
+#endif
 
-    vec4 worldPos = model * localPos;
+#ifdef INSTANCED
+    mat4 world = aModel;
+#else
+    mat4 world = model;
+#endif
+    vec4 worldPos = world * localPos;
     vs_out.FragPos   = worldPos.xyz;
-    vs_out.Normal    = mat3(transpose(inverse(model))) * localNormal;
+    // queueModelAt / Variants_Add only apply rotation + uniform scale, so
+    // mat3(world) is the normal matrix up to length (main.fs normalizes)
+    vs_out.Normal    = mat3(world) * localNormal;
     vs_out.TexCoords = aTexCoords;
+#ifdef TEXTURE_ARRAY
+    vs_out.Material  = aMaterial;
+#endif
+#ifdef BATCHED
+    vs_out.LodFade   = lodFade;
+#endif
+#ifdef INSTANCED
+    vs_out.LodFade   = aLodFade;
+#endif
     gl_Position = projection * view * worldPos;
-}
\ No newline at end of file
+}